@@ -16,6 +16,7 @@ import json
 import logging
 import os
 import random
+import select
 import socket
 import struct
 from collections import deque
@@ -92,6 +93,7 @@ class PresageClient:
         self.video_socket: Optional[socket.socket] = None
         self.connected = False
         self.buffer = ""
+        self.video_buffer = b""
         
         # Metrics history for calculations
         self.pulse_history: deque = deque(maxlen=60)
@@ -121,6 +123,7 @@ class PresageClient:
             self.video_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
             self.video_socket.settimeout(10.0)
             self.video_socket.connect((self.metrics_host, self.video_port))
+            self.video_buffer = b""
             logger.info(f"Connected to Presage video input at {self.metrics_host}:{self.video_port}")
             return True
         except Exception as e:
@@ -191,6 +194,42 @@ class PresageClient:
             self.video_socket = None
             return False
     
+    def read_video_messages(self) -> list[dict]:
+        """
+        Read messages the daemon sent back on the video socket (non-blocking).
+        
+        These are control responses and unsolicited quality_feedback messages,
+        framed like control messages: a 4-byte big-endian length, then JSON.
+        """
+        if not self.video_socket:
+            return []
+        
+        messages = []
+        try:
+            while select.select([self.video_socket], [], [], 0)[0]:
+                data = self.video_socket.recv(4096)
+                if not data:
+                    logger.warning("Video connection closed by daemon")
+                    self.video_socket = None
+                    break
+                self.video_buffer += data
+            
+            while len(self.video_buffer) >= 4:
+                (msg_length,) = struct.unpack(">I", self.video_buffer[:4])
+                if len(self.video_buffer) < 4 + msg_length:
+                    break
+                payload = self.video_buffer[4:4 + msg_length]
+                self.video_buffer = self.video_buffer[4 + msg_length:]
+                try:
+                    messages.append(json.loads(payload))
+                except json.JSONDecodeError:
+                    logger.warning(f"Invalid JSON on video socket: {payload[:200]!r}")
+        except Exception as e:
+            logger.error(f"Error reading from video socket: {e}")
+            self.video_socket = None
+        
+        return messages
+    
     def start_session(
         self, 
         session_id: str, 
@@ -596,6 +635,14 @@ async def websocket_video_input(websocket: WebSocket):
         "type": "ping"
     }
     
+    Quality feedback from the daemon is forwarded as received:
+    {
+        "type": "quality_feedback",
+        "status": "ok" | "poor",
+        "issues": ["blurry", ...],
+        ...
+    }
+    
     Note: If the WebSocket disconnects while a session is active,
     the session will be automatically ended to trigger SDK processing.
     """
@@ -735,6 +782,11 @@ async def websocket_video_input(websocket: WebSocket):
                     "session_id": active_session_id,
                     "frame_count": frame_count,
                 })
+            
+            # Forward quality feedback the daemon pushed on the video socket
+            for message in client.read_video_messages():
+                if message.get("type") == "quality_feedback":
+                    await websocket.send_json(message)
                 
     except WebSocketDisconnect:
         logger.info("Video WebSocket client disconnected")
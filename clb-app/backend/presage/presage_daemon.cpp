@@ -33,6 +33,12 @@
 #include <opencv2/opencv.hpp>
 #include <nlohmann/json.hpp>
 
+#ifdef PRESAGE_HAVE_LIBAVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#endif
+
 #include <string>
 #include <thread>
 #include <atomic>
@@ -42,16 +48,38 @@
 #include <cstdlib>
 #include <vector>
 #include <set>
+#include <map>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <deque>
 #include <condition_variable>
 #include <functional>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <cstring>
+#include <cctype>
 
 // Networking
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <linux/futex.h>
+#include <linux/sockios.h>
 
 using json = nlohmann::json;
 
@@ -63,6 +91,12 @@ struct DaemonConfig {
     std::string api_key;
     int video_input_port = 9001;
     int metrics_output_port = 9002;
+    
+    // Optional AF_UNIX listeners alongside the TCP ports (empty path = disabled)
+    std::string video_input_socket;
+    int video_input_socket_type = SOCK_STREAM;
+    std::string metrics_output_socket;
+    int metrics_output_socket_type = SOCK_STREAM;
     int frame_width = 1280;
     int frame_height = 720;
     bool headless = true;
@@ -73,6 +107,69 @@ struct DaemonConfig {
     int video_fps = 30;
     int segment_duration_seconds = 3;  // Duration of each video segment for real-time processing (reduced from 5s for lower latency)
     int min_segment_frames = 60;  // Minimum frames required for SDK to produce valid metrics
+    std::string tail_policy = "merge";  // Shorter segments: merge | skip | process
+    double bad_status_abort_seconds = 0.0;  // Stop an SDK run after this much video with unusable imaging status; 0 = never
+    
+    // Per-job SDK deadline: max(min, factor x segment duration); factor 0 disables the watchdog
+    double job_deadline_factor = 10.0;
+    int job_deadline_min_seconds = 30;
+    
+    // SDK worker processes (0 = run the SDK on a thread in the daemon)
+    int sdk_workers = 0;
+    size_t sdk_worker_memory_mb = 0;  // Address-space limit per worker; 0 = unlimited
+    std::string segment_ramp;  // Leading segment lengths in seconds, e.g. "2,3" or "min,3"; empty = none
+    std::string recording_codec = "mjpg";  // mjpg | ffv1 | y4m | h264
+    std::string codec_benchmark;  // Comma-separated codecs to rotate through, one per segment
+    bool frame_timestamps = true;  // Write per-segment frame time sidecars for the SDK
+    
+    // Adaptive quality: lengthen segments, halve fps, then halve resolution while the SDK lags
+    bool adaptive_quality = false;
+    size_t adaptive_queue_high = 3;  // Queued segments that count as falling behind
+    
+    // Face-presence gating: skip segments where a face was seen in too few sampled frames
+    double face_gate_coverage = 0.0;  // Minimum fraction of sampled frames with a face; 0 = off
+    int face_detect_interval = 5;     // Run the detector on every Nth recorded frame
+    std::string face_cascade = "/usr/share/opencv4/haarcascades/haarcascade_frontalface_default.xml";
+    
+    // Face-ROI cropping: record a stabilized, padded square around the face instead of the full frame
+    bool face_crop = false;
+    int face_crop_size = 360;          // Output side length in pixels
+    double face_crop_padding = 0.5;    // Margin on each side, as a fraction of the face width
+    
+    // Frame quality screening: drop blurry, badly exposed or shaky frames and tell the client
+    bool quality_screen = false;
+    double quality_min_sharpness = 20.0;  // Variance of the Laplacian on a 320px-wide gray copy
+    double quality_max_clipped = 0.4;     // Fraction of near-black (or near-white) pixels
+    double quality_max_motion = 25.0;     // Mean absolute difference from the previous frame (0-255)
+    
+    // Crash-safe job journal; defaults to <recordings_dir>/segment_journal.jsonl, empty disables
+    std::string journal_path;
+    bool journal_path_set = false;
+    int journal_fsync_ms = 100;  // Max time an appended record waits for fsync
+    
+    // Recording retention (all off by default: recordings are kept)
+    bool retention_delete_processed = false;  // Delete segments once the SDK has processed them
+    int retention_hours = 0;                   // Delete recordings older than this; 0 = forever
+    uint64_t retention_max_mb = 0;             // Evict oldest recordings above this total; 0 = no quota
+    int janitor_interval_seconds = 60;
+    
+    // Content-addressed cache of SDK outputs; empty dir disables it
+    std::string sdk_cache_dir;
+    uint64_t sdk_cache_max_mb = 512;
+    
+    // Stats HTTP endpoint (/metrics, /healthz, /readyz); 0 disables it
+    int stats_port = 9003;
+    size_t ready_max_queue_depth = 8;  // Not ready while more segments than this are waiting
+    int liveness_max_job_seconds = 300;  // Not live if one SDK job runs longer than this
+    
+    // Chrome trace output; tracing starts at launch when set
+    std::string trace_path;
+    
+    // Back pooled frame buffers with transparent hugepages
+    bool frame_pool_hugepages = false;
+    
+    // Parallel decode/resize workers; -1 = auto, 0 = decode inline on the ingest thread
+    int transcode_threads = -1;
 };
 
 void signal_handler(int signal) {
@@ -104,6 +201,23 @@ DaemonConfig load_config() {
         config.metrics_output_port = std::stoi(metrics_port);
     }
     
+    // Unix-domain socket listeners ("stream" or "seqpacket")
+    auto socket_type = [](const char* value) {
+        return (value && std::string(value) == "seqpacket") ? SOCK_SEQPACKET : SOCK_STREAM;
+    };
+    
+    const char* video_socket = std::getenv("VIDEO_INPUT_SOCKET");
+    if (video_socket) {
+        config.video_input_socket = video_socket;
+        config.video_input_socket_type = socket_type(std::getenv("VIDEO_INPUT_SOCKET_TYPE"));
+    }
+    
+    const char* metrics_socket = std::getenv("METRICS_OUTPUT_SOCKET");
+    if (metrics_socket) {
+        config.metrics_output_socket = metrics_socket;
+        config.metrics_output_socket_type = socket_type(std::getenv("METRICS_OUTPUT_SOCKET_TYPE"));
+    }
+    
     // Headless mode
     const char* headless = std::getenv("HEADLESS");
     if (headless) {
@@ -134,6 +248,213 @@ DaemonConfig load_config() {
         config.segment_duration_seconds = std::stoi(segment_duration);
     }
     
+    // Short (tail) segment handling
+    const char* min_segment_frames = std::getenv("PRESAGE_MIN_SEGMENT_FRAMES");
+    if (min_segment_frames) {
+        config.min_segment_frames = std::stoi(min_segment_frames);
+    }
+    
+    const char* segment_ramp = std::getenv("PRESAGE_SEGMENT_RAMP");
+    if (segment_ramp) {
+        config.segment_ramp = segment_ramp;
+    }
+    
+    const char* tail_policy = std::getenv("PRESAGE_TAIL_POLICY");
+    if (tail_policy) {
+        config.tail_policy = tail_policy;
+    }
+    
+    // SDK job watchdog
+    const char* job_deadline_factor = std::getenv("PRESAGE_JOB_DEADLINE_FACTOR");
+    if (job_deadline_factor) {
+        config.job_deadline_factor = std::stod(job_deadline_factor);
+    }
+    
+    const char* job_deadline_min = std::getenv("PRESAGE_JOB_DEADLINE_MIN_SECONDS");
+    if (job_deadline_min) {
+        config.job_deadline_min_seconds = std::stoi(job_deadline_min);
+    }
+    
+    // Process-isolated SDK workers
+    const char* sdk_workers = std::getenv("PRESAGE_SDK_WORKERS");
+    if (sdk_workers) {
+        config.sdk_workers = std::stoi(sdk_workers);
+    }
+    
+    const char* sdk_worker_memory = std::getenv("PRESAGE_SDK_WORKER_MEMORY_MB");
+    if (sdk_worker_memory) {
+        config.sdk_worker_memory_mb = std::stoul(sdk_worker_memory);
+    }
+    
+    // Early abort on sustained bad imaging status
+    const char* bad_status_abort = std::getenv("PRESAGE_BAD_STATUS_ABORT_SECONDS");
+    if (bad_status_abort) {
+        config.bad_status_abort_seconds = std::stod(bad_status_abort);
+    }
+    
+    // Recording codec
+    const char* recording_codec = std::getenv("PRESAGE_RECORDING_CODEC");
+    if (recording_codec) {
+        config.recording_codec = recording_codec;
+    }
+    
+    const char* codec_benchmark = std::getenv("PRESAGE_CODEC_BENCHMARK");
+    if (codec_benchmark) {
+        config.codec_benchmark = codec_benchmark;
+    }
+    
+    // Segment journal
+    const char* journal_path = std::getenv("PRESAGE_JOURNAL_PATH");
+    if (journal_path) {
+        config.journal_path = journal_path;
+        config.journal_path_set = true;
+    }
+    
+    const char* journal_fsync_ms = std::getenv("PRESAGE_JOURNAL_FSYNC_MS");
+    if (journal_fsync_ms) {
+        config.journal_fsync_ms = std::stoi(journal_fsync_ms);
+    }
+    
+    // Recording retention
+    const char* delete_processed = std::getenv("PRESAGE_RETENTION_DELETE_PROCESSED");
+    if (delete_processed) {
+        config.retention_delete_processed = (std::string(delete_processed) == "true" || std::string(delete_processed) == "1");
+    }
+    
+    const char* retention_hours = std::getenv("PRESAGE_RETENTION_HOURS");
+    if (retention_hours) {
+        config.retention_hours = std::stoi(retention_hours);
+    }
+    
+    const char* retention_max_mb = std::getenv("PRESAGE_RETENTION_MAX_MB");
+    if (retention_max_mb) {
+        config.retention_max_mb = std::stoull(retention_max_mb);
+    }
+    
+    const char* janitor_interval = std::getenv("PRESAGE_JANITOR_INTERVAL_SECONDS");
+    if (janitor_interval) {
+        config.janitor_interval_seconds = std::stoi(janitor_interval);
+    }
+    
+    // SDK result cache
+    const char* sdk_cache_dir = std::getenv("PRESAGE_SDK_CACHE_DIR");
+    if (sdk_cache_dir) {
+        config.sdk_cache_dir = sdk_cache_dir;
+    }
+    
+    const char* sdk_cache_max_mb = std::getenv("PRESAGE_SDK_CACHE_MAX_MB");
+    if (sdk_cache_max_mb) {
+        config.sdk_cache_max_mb = std::stoull(sdk_cache_max_mb);
+    }
+    
+    const char* frame_timestamps = std::getenv("PRESAGE_FRAME_TIMESTAMPS");
+    if (frame_timestamps) {
+        config.frame_timestamps = (std::string(frame_timestamps) == "true" || std::string(frame_timestamps) == "1");
+    }
+    
+    // Adaptive quality controller
+    const char* adaptive_quality = std::getenv("PRESAGE_ADAPTIVE_QUALITY");
+    if (adaptive_quality) {
+        config.adaptive_quality = (std::string(adaptive_quality) == "true" || std::string(adaptive_quality) == "1");
+    }
+    
+    const char* adaptive_queue_high = std::getenv("PRESAGE_ADAPTIVE_QUEUE_HIGH");
+    if (adaptive_queue_high) {
+        config.adaptive_queue_high = std::stoul(adaptive_queue_high);
+    }
+    
+    // Face-presence gating
+    const char* face_gate_coverage = std::getenv("PRESAGE_FACE_GATE_COVERAGE");
+    if (face_gate_coverage) {
+        config.face_gate_coverage = std::stod(face_gate_coverage);
+    }
+    
+    const char* face_detect_interval = std::getenv("PRESAGE_FACE_DETECT_INTERVAL");
+    if (face_detect_interval) {
+        config.face_detect_interval = std::stoi(face_detect_interval);
+    }
+    
+    const char* face_cascade = std::getenv("PRESAGE_FACE_CASCADE");
+    if (face_cascade) {
+        config.face_cascade = face_cascade;
+    }
+    
+    // Face-ROI cropping
+    const char* face_crop = std::getenv("PRESAGE_FACE_CROP");
+    if (face_crop) {
+        config.face_crop = (std::string(face_crop) == "true" || std::string(face_crop) == "1");
+    }
+    
+    const char* face_crop_size = std::getenv("PRESAGE_FACE_CROP_SIZE");
+    if (face_crop_size) {
+        config.face_crop_size = std::stoi(face_crop_size);
+    }
+    
+    const char* face_crop_padding = std::getenv("PRESAGE_FACE_CROP_PADDING");
+    if (face_crop_padding) {
+        config.face_crop_padding = std::stod(face_crop_padding);
+    }
+    
+    // Frame quality screening
+    const char* quality_screen = std::getenv("PRESAGE_QUALITY_SCREEN");
+    if (quality_screen) {
+        config.quality_screen = (std::string(quality_screen) == "true" || std::string(quality_screen) == "1");
+    }
+    
+    const char* quality_min_sharpness = std::getenv("PRESAGE_QUALITY_MIN_SHARPNESS");
+    if (quality_min_sharpness) {
+        config.quality_min_sharpness = std::stod(quality_min_sharpness);
+    }
+    
+    const char* quality_max_clipped = std::getenv("PRESAGE_QUALITY_MAX_CLIPPED");
+    if (quality_max_clipped) {
+        config.quality_max_clipped = std::stod(quality_max_clipped);
+    }
+    
+    const char* quality_max_motion = std::getenv("PRESAGE_QUALITY_MAX_MOTION");
+    if (quality_max_motion) {
+        config.quality_max_motion = std::stod(quality_max_motion);
+    }
+    
+    // Stats HTTP endpoint
+    const char* stats_port = std::getenv("PRESAGE_STATS_PORT");
+    if (stats_port) {
+        config.stats_port = std::stoi(stats_port);
+    }
+    
+    const char* ready_max_queue = std::getenv("PRESAGE_READY_MAX_QUEUE");
+    if (ready_max_queue) {
+        config.ready_max_queue_depth = std::stoul(ready_max_queue);
+    }
+    
+    const char* liveness_max_job = std::getenv("PRESAGE_LIVENESS_MAX_JOB_SECONDS");
+    if (liveness_max_job) {
+        config.liveness_max_job_seconds = std::stoi(liveness_max_job);
+    }
+    
+    // Pipeline tracing
+    const char* trace_path = std::getenv("PRESAGE_TRACE_PATH");
+    if (trace_path) {
+        config.trace_path = trace_path;
+    }
+    
+    // Frame buffer pool
+    const char* pool_hugepages = std::getenv("PRESAGE_FRAME_POOL_HUGEPAGES");
+    if (pool_hugepages) {
+        config.frame_pool_hugepages = (std::string(pool_hugepages) == "true" || std::string(pool_hugepages) == "1");
+    }
+    
+    // Parallel frame transcoding
+    const char* transcode_threads = std::getenv("PRESAGE_TRANSCODE_THREADS");
+    if (transcode_threads) {
+        config.transcode_threads = std::stoi(transcode_threads);
+    }
+    if (config.transcode_threads < 0) {
+        // Leave cores for the SDK worker; a single worker would only add hand-off latency
+        int auto_threads = std::min(4, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+        config.transcode_threads = auto_threads >= 2 ? auto_threads : 0;
+    }
+    
     return config;
 }
 
@@ -149,1017 +470,5866 @@ std::string status_to_json(const std::string& status, const std::string& message
     return j.dump();
 }
 
+/**
+ * Create a listening AF_UNIX socket at the given path.
+ * Any stale socket file left by a previous run is removed first.
+ * 
+ * @param type SOCK_STREAM or SOCK_SEQPACKET
+ * @return Listening fd, or -1 on failure
+ */
+int create_unix_listener(const std::string& path, int type, int backlog) {
+    struct sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path)) {
+        LOG(ERROR) << "Unix socket path too long: " << path;
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0) {
+        LOG(ERROR) << "Failed to create unix socket for " << path;
+        return -1;
+    }
+    
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(path.c_str());
+    
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        LOG(ERROR) << "Failed to bind unix socket " << path << ": " << strerror(errno);
+        close(fd);
+        return -1;
+    }
+    
+    if (listen(fd, backlog) < 0) {
+        LOG(ERROR) << "Failed to listen on unix socket " << path;
+        close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    
+    return fd;
+}
+
+const char* socket_type_name(int type) {
+    return type == SOCK_SEQPACKET ? "seqpacket" : "stream";
+}
+
+/**
+ * Monotonic timestamps stamped at each stage of the frame -> metrics pipeline.
+ * Carried with every segment job so emitted messages can report where the
+ * time went. Unset stages stay at the epoch of steady_clock.
+ */
+struct PipelineTimestamps {
+    using Clock = std::chrono::steady_clock;
+    
+    Clock::time_point first_frame_received;
+    Clock::time_point last_frame_received;
+    Clock::time_point segment_finalized;
+    Clock::time_point job_dequeued;
+    Clock::time_point sdk_initialized;
+    Clock::time_point first_callback;
+    Clock::time_point run_completed;
+};
+
+// Milliseconds between two stamps, or -1 if either stage has not happened
+double stage_ms(PipelineTimestamps::Clock::time_point from, PipelineTimestamps::Clock::time_point to) {
+    if (from == PipelineTimestamps::Clock::time_point{} || to == PipelineTimestamps::Clock::time_point{}) {
+        return -1.0;
+    }
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/**
+ * Convert pipeline stamps to per-stage durations (ms).
+ * 
+ * @param t Stamps collected so far for the job
+ * @param broadcast_at When the message carrying this object is sent
+ */
+json pipeline_latency_to_json(const PipelineTimestamps& t,
+                              PipelineTimestamps::Clock::time_point broadcast_at) {
+    json j;
+    auto put = [&j](const char* key, double ms) {
+        if (ms >= 0.0) {
+            j[key] = ms;
+        }
+    };
+    
+    put("capture_ms", stage_ms(t.first_frame_received, t.last_frame_received));
+    put("finalize_ms", stage_ms(t.last_frame_received, t.segment_finalized));
+    put("queue_wait_ms", stage_ms(t.segment_finalized, t.job_dequeued));
+    put("sdk_init_ms", stage_ms(t.job_dequeued, t.sdk_initialized));
+    put("sdk_first_result_ms", stage_ms(t.sdk_initialized, t.first_callback));
+    put("sdk_run_ms", stage_ms(t.sdk_initialized, t.run_completed));
+    put("end_to_end_ms", stage_ms(t.last_frame_received, broadcast_at));
+    return j;
+}
+
 // ============================================================================
-// Session Recorder - Records video frames with real-time segment processing
+// Daemon Stats - Counters, gauges and histograms for the stats HTTP endpoint
 // ============================================================================
 
-class SessionRecorder {
+/**
+ * Fixed-bucket histogram rendered in Prometheus text format.
+ */
+class Histogram {
 public:
-    // Segment processing callback type
-    using SegmentReadyCallback = std::function<void(const std::string& video_path, 
-                                                     const std::string& session_id,
-                                                     size_t segment_index)>;
+    explicit Histogram(std::vector<double> bounds)
+        : bounds_(std::move(bounds)), counts_(bounds_.size() + 1, 0) {}
+    
+    void observe(double value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+        counts_[bucket]++;
+        sum_ += value;
+        count_++;
+    }
+    
+    void render(std::ostringstream& out, const std::string& name, const std::string& help) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < bounds_.size(); ++i) {
+            cumulative += counts_[i];
+            out << name << "_bucket{le=\"" << bounds_[i] << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << count_ << "\n";
+        out << name << "_sum " << sum_ << "\n";
+        out << name << "_count " << count_ << "\n";
+    }
+    
+private:
+    std::vector<double> bounds_;
+    std::vector<uint64_t> counts_;
+    double sum_ = 0.0;
+    uint64_t count_ = 0;
+    mutable std::mutex mutex_;
+};
 
-    SessionRecorder(const std::string& recordings_dir, int default_fps = 30, 
-                    int segment_duration_seconds = 5)
-        : recordings_dir_(recordings_dir), default_fps_(default_fps), 
-          segment_duration_seconds_(segment_duration_seconds), recording_(false),
-          total_frame_count_(0), current_segment_index_(0) {
-        // Create recordings directory if it doesn't exist
-        createDirectory(recordings_dir_);
+/**
+ * Process-wide counters updated from the ingest, recording and SDK paths.
+ * Gauges (queue depth, connected clients) are sampled at scrape time instead.
+ */
+struct DaemonStats {
+    std::atomic<uint64_t> frames_received{0};
+    std::atomic<uint64_t> frames_decoded{0};
+    std::atomic<uint64_t> frames_decode_failed{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> recv_calls{0};
+    std::atomic<uint64_t> frames_resized{0};
+    std::atomic<uint64_t> frame_pool_allocations{0};  // New blocks carved by FrameBufferPool
+    std::atomic<uint64_t> frame_pool_reuses{0};       // Blocks handed out again from a free list
+    std::atomic<uint64_t> decode_allocations{0};      // imdecode had to allocate outside the pool
+    std::atomic<uint64_t> frames_reduced_decode{0};   // JPEGs decoded at 1/2, 1/4 or 1/8 scale
+    std::atomic<uint64_t> frames_raw{0};              // NV12/I420 frames converted without imdecode
+    std::atomic<uint64_t> resize_allocations{0};      // cv::resize target had to be reallocated
+    std::atomic<uint64_t> frames_decimated{0};        // Dropped by the recorder at a reduced quality level
+    std::atomic<uint64_t> face_detections{0};         // Sampled frames run through the face detector
+    std::atomic<uint64_t> segments_no_face{0};        // Segments skipped for too little face coverage
+    std::atomic<uint64_t> frames_dropped_quality{0};  // Failed the blur/exposure/motion screen
+    std::atomic<uint64_t> quality_feedback_sent{0};
+    std::atomic<uint64_t> quality_feedback_dropped{0};  // Video client's socket buffer was full
+    std::atomic<uint64_t> sdk_runs_aborted{0};        // Stopped early on sustained bad imaging status
+    std::atomic<uint64_t> sdk_jobs_timed_out{0};      // Passed their watchdog deadline
+    std::atomic<uint64_t> sdk_runners_abandoned{0};   // Runner threads left behind on a hung SDK call
+    std::atomic<uint64_t> sdk_worker_spawns{0};       // SDK worker processes started
+    std::atomic<uint64_t> sdk_worker_crashes{0};      // Worker processes that died mid-job
+    std::atomic<uint64_t> sdk_cache_hits{0};          // SDK runs replayed from the result cache
+    std::atomic<uint64_t> sdk_cache_misses{0};
+    std::atomic<uint64_t> sdk_cache_evictions{0};
+    std::atomic<uint64_t> segments_finalized{0};
+    std::atomic<uint64_t> metrics_broadcasts{0};
+    std::atomic<uint64_t> janitor_files_deleted{0};
+    std::atomic<uint64_t> janitor_bytes_deleted{0};
+    std::atomic<uint64_t> recordings_bytes{0};  // Gauge, refreshed by each janitor sweep
+    std::atomic<uint64_t> quality_level{0};     // Gauge, set by the adaptive quality controller
+    std::atomic<uint64_t> sdk_cache_bytes{0};   // Gauge, size of the SDK result cache
+    
+    Histogram job_wait_seconds{{0.01, 0.05, 0.1, 0.5, 1, 2.5, 5, 10, 30, 60}};
+    Histogram job_run_seconds{{0.5, 1, 2.5, 5, 10, 20, 30, 60, 120}};
+    Histogram sdk_init_seconds{{0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10}};
+};
+
+DaemonStats g_stats;
+
+// ============================================================================
+// Pipeline Tracer - Chrome trace-event spans in lock-free per-thread buffers
+// ============================================================================
+
+/**
+ * Opt-in span recorder producing Chrome trace-event JSON (viewable in Perfetto).
+ * 
+ * Each thread appends to its own fixed-size buffer, so recording a span is a
+ * couple of relaxed loads and one release store - no locks on the hot path.
+ * The registry mutex is only taken the first time a thread records and when
+ * a trace is started or written out.
+ */
+class PipelineTracer {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    static PipelineTracer& instance() {
+        static PipelineTracer tracer;
+        return tracer;
     }
     
-    ~SessionRecorder() {
-        stopRecording();
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
     }
     
     /**
-     * Set callback for when a segment is ready for processing.
-     * This enables real-time processing of video segments.
+     * Begin a new trace. Events from any previous trace are discarded.
      */
-    void setSegmentReadyCallback(SegmentReadyCallback callback) {
-        segment_ready_callback_ = callback;
+    void start(const std::string& path) {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        path_ = path;
+        generation_.fetch_add(1, std::memory_order_release);
+        enabled_.store(true, std::memory_order_release);
+        LOG(INFO) << "Pipeline tracing started -> " << path_;
     }
     
     /**
-     * Start a new recording session with real-time segment processing.
+     * Stop tracing and write the collected events.
      * 
-     * @param session_id Unique session identifier (used in filename)
-     * @param fps Frame rate for the video (default: 30)
-     * @param width Frame width (0 = auto-detect from first frame)
-     * @param height Frame height (0 = auto-detect from first frame)
-     * @return true if session started successfully
+     * @param event_count Receives the number of spans written
+     * @return Path of the written trace, or empty string if tracing was off or the write failed
      */
-    bool startSession(const std::string& session_id, int fps = 0, int width = 0, int height = 0) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        if (recording_) {
-            LOG(WARNING) << "Recording already in progress for session " << current_session_id_;
-            return false;
+    std::string stop(size_t* event_count = nullptr) {
+        if (!enabled_.exchange(false, std::memory_order_acq_rel)) {
+            return "";
         }
         
-        current_session_id_ = session_id;
-        session_fps_ = (fps > 0) ? fps : default_fps_;
-        session_width_ = width;
-        session_height_ = height;
-        
-        // Calculate frames per segment
-        frames_per_segment_ = session_fps_ * segment_duration_seconds_;
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        uint64_t generation = generation_.load(std::memory_order_acquire);
         
-        recording_ = true;
-        total_frame_count_ = 0;
-        segment_frame_count_ = 0;
-        current_segment_index_ = 0;
-        
-        // Start first segment
-        startNewSegment();
+        std::ofstream out(path_);
+        if (!out) {
+            LOG(ERROR) << "Failed to open trace output " << path_;
+            return "";
+        }
         
-        LOG(INFO) << "Started recording session " << session_id 
-                  << " at " << session_fps_ << " fps"
-                  << " with " << segment_duration_seconds_ << "s segments ("
-                  << frames_per_segment_ << " frames/segment)";
+        int pid = static_cast<int>(getpid());
+        size_t written = 0;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& buffer : buffers_) {
+            out << (first ? "" : ",")
+                << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":" << json(buffer->name).dump() << "}}";
+            first = false;
+            
+            if (buffer->generation.load(std::memory_order_acquire) != generation) {
+                continue;
+            }
+            size_t count = std::min(buffer->count.load(std::memory_order_acquire), buffer->events.size());
+            for (size_t i = 0; i < count; ++i) {
+                const Event& e = buffer->events[i];
+                out << ",{\"ph\":\"X\",\"name\":\"" << e.name << "\",\"cat\":\"pipeline\""
+                    << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                    << ",\"ts\":" << e.start_us << ",\"dur\":" << e.dur_us;
+                if (e.arg >= 0) {
+                    out << ",\"args\":{\"value\":" << e.arg << "}";
+                }
+                out << "}";
+            }
+            written += count;
+        }
+        out << "]}\n";
         
-        return true;
+        LOG(INFO) << "Pipeline trace written: " << written << " spans -> " << path_;
+        if (event_count) {
+            *event_count = written;
+        }
+        return path_;
     }
     
     /**
-     * Add a frame to the current recording.
-     * Automatically creates new segments and triggers processing.
+     * Name the calling thread in trace output (e.g. "ingest", "sdk_worker").
+     */
+    void setThreadName(const std::string& name) {
+        ThreadBuffer* buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        buffer->name = name;
+    }
+    
+    /**
+     * Record a completed span on the calling thread.
      * 
-     * @param frame The frame to record (BGR format)
-     * @return true if frame was recorded successfully
+     * @param name Static span name (must outlive the trace)
+     * @param arg Optional numeric argument (e.g. segment index, bytes), -1 for none
      */
-    bool addFrame(const cv::Mat& frame) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        if (!recording_) {
-            return false;
-        }
-        
-        if (frame.empty()) {
-            LOG(WARNING) << "Attempted to record empty frame";
-            return false;
+    void record(const char* name, Clock::time_point start, Clock::time_point end, int64_t arg = -1) {
+        if (!enabled()) {
+            return;
         }
+        ThreadBuffer* buffer = threadBuffer();
         
-        // Initialize writer on first frame if dimensions weren't specified
-        if (!writer_.isOpened()) {
-            if (!initializeWriter(frame.cols, frame.rows)) {
-                recording_ = false;
-                return false;
+        // Owner thread resets its own buffer when a new trace begins; storage is
+        // only allocated once a thread actually records while tracing is on
+        uint64_t generation = generation_.load(std::memory_order_acquire);
+        if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+            if (buffer->events.empty()) {
+                buffer->events.resize(kEventsPerThread);
             }
+            buffer->count.store(0, std::memory_order_relaxed);
+            buffer->generation.store(generation, std::memory_order_release);
         }
         
-        // Resize frame if it doesn't match expected dimensions
-        cv::Mat frame_to_write;
-        if (frame.cols != session_width_ || frame.rows != session_height_) {
-            cv::resize(frame, frame_to_write, cv::Size(session_width_, session_height_));
-        } else {
-            frame_to_write = frame;
+        size_t index = buffer->count.load(std::memory_order_relaxed);
+        if (index >= buffer->events.size()) {
+            return;  // Buffer full - drop rather than block
         }
-        
-        writer_.write(frame_to_write);
-        total_frame_count_++;
-        segment_frame_count_++;
-        
-        // Check if segment is complete
-        if (segment_frame_count_ >= frames_per_segment_) {
-            finalizeCurrentSegment();
-            startNewSegment();
+        Event& e = buffer->events[index];
+        e.name = name;
+        e.start_us = std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count();
+        e.dur_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        e.arg = arg;
+        buffer->count.store(index + 1, std::memory_order_release);
+    }
+    
+private:
+    static constexpr size_t kEventsPerThread = 1 << 16;
+    
+    struct Event {
+        const char* name;
+        int64_t start_us;
+        int64_t dur_us;
+        int64_t arg;
+    };
+    
+    struct ThreadBuffer {
+        std::vector<Event> events;
+        std::atomic<size_t> count{0};
+        std::atomic<uint64_t> generation{0};
+        int tid = 0;
+        std::string name;
+    };
+    
+    ThreadBuffer* threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            auto owned = std::make_unique<ThreadBuffer>();
+            owned->tid = static_cast<int>(syscall(SYS_gettid));
+            owned->name = "thread-" + std::to_string(owned->tid);
+            buffer = owned.get();
+            
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            buffers_.push_back(std::move(owned));
         }
-        
-        return true;
+        return buffer;
     }
     
-    /**
-     * Stop the current recording session.
-     * Finalizes any remaining segment.
-     * 
-     * @return Path to the final segment video file, or empty string if no recording was active
-     */
-    std::string stopRecording() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        if (!recording_) {
-            return "";
-        }
-        
-        recording_ = false;
-        
-        // Finalize current segment if it has frames
-        std::string final_path = "";
-        if (segment_frame_count_ > 0 && writer_.isOpened()) {
-            final_path = finalizeCurrentSegmentLocked();
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> generation_{0};
+    std::mutex registry_mutex_;
+    std::string path_;
+    // Buffers outlive their threads so a trace can still be written after a client disconnects
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+/**
+ * RAII span: records [construction, destruction) when tracing is on.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, int64_t arg = -1)
+        : name_(name), arg_(arg), active_(PipelineTracer::instance().enabled()) {
+        if (active_) {
+            start_ = PipelineTracer::Clock::now();
         }
-        
-        LOG(INFO) << "Stopped recording session " << current_session_id_ 
-                  << " - " << total_frame_count_ << " total frames"
-                  << " across " << (current_segment_index_ + 1) << " segments";
-        
-        // Reset state
-        current_session_id_.clear();
-        current_video_path_.clear();
-        total_frame_count_ = 0;
-        segment_frame_count_ = 0;
-        current_segment_index_ = 0;
-        
-        return final_path;
     }
     
-    /**
-     * Check if a recording is currently active.
-     */
-    bool isRecording() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return recording_;
+    ~TraceSpan() {
+        if (active_) {
+            PipelineTracer::instance().record(name_, start_, PipelineTracer::Clock::now(), arg_);
+        }
     }
     
-    /**
-     * Get the current session ID.
-     */
-    std::string getCurrentSessionId() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return current_session_id_;
-    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
     
-    /**
-     * Get the current video file path.
-     */
-    std::string getCurrentVideoPath() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return current_video_path_;
-    }
+private:
+    const char* name_;
+    int64_t arg_;
+    bool active_;
+    PipelineTracer::Clock::time_point start_;
+};
+
+// ============================================================================
+// Frame Buffer Pool - Recycled, size-classed storage for decoded frames
+// ============================================================================
+
+class FrameBufferPool;
+
+/**
+ * Move-only cv::Mat whose pixels live in a pooled block.
+ * The block goes back to the pool when this is destroyed. If OpenCV had to
+ * reallocate `mat` (e.g. a decode produced a different size), the Mat simply
+ * owns its own memory and the block is still returned.
+ */
+class PooledMat {
+public:
+    PooledMat() = default;
+    ~PooledMat();
     
-    /**
-     * Get the total number of frames recorded in the current session.
-     */
-    size_t getFrameCount() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return total_frame_count_;
-    }
+    PooledMat(PooledMat&& other) noexcept { *this = std::move(other); }
+    PooledMat& operator=(PooledMat&& other) noexcept;
+    PooledMat(const PooledMat&) = delete;
+    PooledMat& operator=(const PooledMat&) = delete;
     
-    /**
-     * Get the recordings directory path.
-     */
-    std::string getRecordingsDir() const {
-        return recordings_dir_;
-    }
+    // True while `mat` still points at pooled storage
+    bool pooled() const { return block_ != nullptr && mat.data == block_; }
     
-    /**
-     * Get segment duration in seconds.
-     */
-    int getSegmentDuration() const {
-        return segment_duration_seconds_;
-    }
+    cv::Mat mat;
     
 private:
-    void startNewSegment() {
-        // Generate segment filename
-        auto now = std::chrono::system_clock::now();
-        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
-        
-        current_video_path_ = recordings_dir_ + "/" + current_session_id_ + 
-                              "_seg" + std::to_string(current_segment_index_) + 
-                              "_" + std::to_string(timestamp) + ".avi";
-        
-        // Initialize writer if we have dimensions
-        if (session_width_ > 0 && session_height_ > 0) {
-            initializeWriter(session_width_, session_height_);
-        }
-        
-        segment_frame_count_ = 0;
-        
-        LOG(INFO) << "Started segment " << current_segment_index_ 
-                  << " for session " << current_session_id_;
-    }
+    friend class FrameBufferPool;
     
-    void finalizeCurrentSegment() {
-        // This version is called from addFrame, doesn't hold lock
-        finalizeCurrentSegmentLocked();
-        current_segment_index_++;
+    FrameBufferPool* pool_ = nullptr;
+    uint8_t* block_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+/**
+ * Size-classed pool of frame-sized blocks.
+ * 
+ * Capacities are rounded up to a power of two so frames of slightly different
+ * sizes share a class. With hugepages enabled, blocks are mmap'ed and advised
+ * MADV_HUGEPAGE to cut TLB pressure on 1080p frames. At steady state the
+ * allocation counters stop moving.
+ */
+class FrameBufferPool {
+public:
+    explicit FrameBufferPool(bool use_hugepages = false, size_t max_free_per_class = 8)
+        : use_hugepages_(use_hugepages), max_free_per_class_(max_free_per_class) {}
+    
+    ~FrameBufferPool() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [capacity, blocks] : free_blocks_) {
+            for (uint8_t* block : blocks) {
+                freeBlock(block, capacity);
+            }
+        }
     }
     
-    std::string finalizeCurrentSegmentLocked() {
-        if (writer_.isOpened()) {
-            writer_.release();
+    /**
+     * Get a Mat header of the given size/type over pooled storage.
+     * Returns an empty PooledMat for an empty size.
+     */
+    PooledMat acquire(cv::Size size, int type) {
+        PooledMat result;
+        if (size.empty()) {
+            return result;
         }
         
-        std::string completed_path = current_video_path_;
-        std::string session_id = current_session_id_;
-        size_t segment_idx = current_segment_index_;
-        size_t frames = segment_frame_count_;
-        
-        LOG(INFO) << "Completed segment " << segment_idx 
-                  << " with " << frames << " frames"
-                  << " -> " << completed_path;
+        size_t bytes = static_cast<size_t>(size.area()) * CV_ELEM_SIZE(type);
+        size_t capacity = sizeClass(bytes);
+        uint8_t* block = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& blocks = free_blocks_[capacity];
+            if (!blocks.empty()) {
+                block = blocks.back();
+                blocks.pop_back();
+            }
+        }
         
-        // Trigger callback for segment processing
-        // The callback just queues to SDK processor (very fast), so call directly
-        if (segment_ready_callback_ && frames > 0) {
-            segment_ready_callback_(completed_path, session_id, segment_idx);
+        if (block) {
+            g_stats.frame_pool_reuses++;
+        } else {
+            block = allocateBlock(capacity);
+            if (!block) {
+                return result;
+            }
+            g_stats.frame_pool_allocations++;
         }
         
-        return completed_path;
+        result.pool_ = this;
+        result.block_ = block;
+        result.capacity_ = capacity;
+        result.mat = cv::Mat(size, type, block);
+        return result;
     }
     
-    bool initializeWriter(int width, int height) {
-        session_width_ = width;
-        session_height_ = height;
-        
-        // Use MJPG codec for good compatibility and quality
-        int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
-        
-        writer_.open(current_video_path_, fourcc, session_fps_, 
-                     cv::Size(session_width_, session_height_), true);
-        
-        if (!writer_.isOpened()) {
-            LOG(ERROR) << "Failed to open VideoWriter for " << current_video_path_;
-            return false;
+private:
+    friend class PooledMat;
+    
+    static constexpr size_t kMinBlockBytes = 64 * 1024;
+    static constexpr size_t kHugePageBytes = 2 * 1024 * 1024;
+    
+    static size_t sizeClass(size_t bytes) {
+        size_t capacity = kMinBlockBytes;
+        while (capacity < bytes) {
+            capacity <<= 1;
         }
-        
-        LOG(INFO) << "Initialized VideoWriter: " << session_width_ << "x" << session_height_ 
-                  << " @ " << session_fps_ << " fps (MJPG)";
-        
-        return true;
+        return capacity;
     }
     
-    bool createDirectory(const std::string& path) {
-        // Simple directory creation using system call
-        std::string cmd = "mkdir -p \"" + path + "\"";
-        int result = system(cmd.c_str());
-        if (result != 0) {
-            LOG(WARNING) << "Could not create directory: " << path;
-            return false;
+    void release(uint8_t* block, size_t capacity) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& blocks = free_blocks_[capacity];
+            if (blocks.size() < max_free_per_class_) {
+                blocks.push_back(block);
+                return;
+            }
         }
-        LOG(INFO) << "Ensured recordings directory exists: " << path;
-        return true;
+        freeBlock(block, capacity);
     }
     
-    std::string recordings_dir_;
-    int default_fps_;
-    int segment_duration_seconds_;
+    uint8_t* allocateBlock(size_t capacity) {
+        if (use_hugepages_ && capacity >= kHugePageBytes) {
+            void* block = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (block == MAP_FAILED) {
+                LOG(WARNING) << "Frame pool mmap failed: " << strerror(errno);
+                return nullptr;
+            }
+            madvise(block, capacity, MADV_HUGEPAGE);
+            return static_cast<uint8_t*>(block);
+        }
+        void* block = nullptr;
+        if (posix_memalign(&block, 64, capacity) != 0) {
+            return nullptr;
+        }
+        return static_cast<uint8_t*>(block);
+    }
     
-    mutable std::mutex mutex_;
-    bool recording_;
-    std::string current_session_id_;
-    std::string current_video_path_;
-    int session_fps_;
-    int session_width_;
-    int session_height_;
-    size_t total_frame_count_;
-    size_t segment_frame_count_;
-    size_t frames_per_segment_;
-    size_t current_segment_index_;
+    void freeBlock(uint8_t* block, size_t capacity) {
+        if (use_hugepages_ && capacity >= kHugePageBytes) {
+            munmap(block, capacity);
+        } else {
+            free(block);
+        }
+    }
     
-    cv::VideoWriter writer_;
-    SegmentReadyCallback segment_ready_callback_;
+    bool use_hugepages_;
+    size_t max_free_per_class_;
+    std::mutex mutex_;
+    std::map<size_t, std::vector<uint8_t*>> free_blocks_;
 };
 
-// Global session recorder (initialized in main)
-std::unique_ptr<SessionRecorder> g_session_recorder;
+PooledMat::~PooledMat() {
+    mat.release();
+    if (pool_ && block_) {
+        pool_->release(block_, capacity_);
+    }
+}
 
-// Forward declarations
-class MetricsServer;
-class SDKVideoProcessor;
+PooledMat& PooledMat::operator=(PooledMat&& other) noexcept {
+    if (this != &other) {
+        mat.release();
+        if (pool_ && block_) {
+            pool_->release(block_, capacity_);
+        }
+        mat = std::move(other.mat);
+        pool_ = other.pool_;
+        block_ = other.block_;
+        capacity_ = other.capacity_;
+        other.pool_ = nullptr;
+        other.block_ = nullptr;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
 
-// Global pointers (initialized in main)
-MetricsServer* g_metrics_server = nullptr;
-std::unique_ptr<SDKVideoProcessor> g_sdk_processor;
+// Global frame pool (initialized in main, outlives the ingest threads)
+std::unique_ptr<FrameBufferPool> g_frame_pool;
 
-// TCP Server for metrics output
-class MetricsServer {
+// ============================================================================
+// Segment Writers - Recording codec and container selection
+// ============================================================================
+
+enum class RecordingCodec {
+    kMJPG,  // Motion JPEG in .avi (lossy, the historical default)
+    kFFV1,  // FFV1 lossless in .mkv
+    kY4M,   // Uncompressed 4:2:0 YUV4MPEG2
+    kH264,  // H.264 in .mp4 via OpenCV's FFmpeg backend
+};
+
+bool parse_recording_codec(const std::string& name, RecordingCodec* codec) {
+    if (name == "mjpg") {
+        *codec = RecordingCodec::kMJPG;
+    } else if (name == "ffv1") {
+        *codec = RecordingCodec::kFFV1;
+    } else if (name == "y4m") {
+        *codec = RecordingCodec::kY4M;
+    } else if (name == "h264") {
+        *codec = RecordingCodec::kH264;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* recording_codec_name(RecordingCodec codec) {
+    switch (codec) {
+        case RecordingCodec::kFFV1: return "ffv1";
+        case RecordingCodec::kY4M: return "y4m";
+        case RecordingCodec::kH264: return "h264";
+        case RecordingCodec::kMJPG: break;
+    }
+    return "mjpg";
+}
+
+const char* recording_codec_extension(RecordingCodec codec) {
+    switch (codec) {
+        case RecordingCodec::kFFV1: return ".mkv";
+        case RecordingCodec::kY4M: return ".y4m";
+        case RecordingCodec::kH264: return ".mp4";
+        case RecordingCodec::kMJPG: break;
+    }
+    return ".avi";
+}
+
+/**
+ * Parse a comma-separated codec list (e.g. PRESAGE_CODEC_BENCHMARK).
+ * Unknown names are logged and skipped.
+ */
+std::vector<RecordingCodec> parse_recording_codec_list(const std::string& list) {
+    std::vector<RecordingCodec> codecs;
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        RecordingCodec codec;
+        if (parse_recording_codec(name, &codec)) {
+            codecs.push_back(codec);
+        } else if (!name.empty()) {
+            LOG(WARNING) << "Ignoring unknown recording codec: " << name;
+        }
+    }
+    return codecs;
+}
+
+/**
+ * Writes one recording segment. Frames are BGR at the size given to open().
+ */
+class SegmentWriter {
+public:
+    virtual ~SegmentWriter() = default;
+    virtual bool open(const std::string& path, int fps, cv::Size size) = 0;
+    virtual void write(const cv::Mat& frame) = 0;
+    virtual void release() = 0;
+    virtual bool isOpened() const = 0;
+};
+
+/**
+ * cv::VideoWriter-backed segments (MJPG, FFV1, H.264).
+ */
+class OpenCVSegmentWriter : public SegmentWriter {
 public:
-    MetricsServer(int port) : port_(port), server_fd_(-1), running_(false) {}
+    explicit OpenCVSegmentWriter(int fourcc) : fourcc_(fourcc) {}
     
-    ~MetricsServer() {
-        stop();
+    bool open(const std::string& path, int fps, cv::Size size) override {
+        return writer_.open(path, fourcc_, fps, size, true);
     }
+    void write(const cv::Mat& frame) override { writer_.write(frame); }
+    void release() override { writer_.release(); }
+    bool isOpened() const override { return writer_.isOpened(); }
     
-    bool start() {
-        server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-        if (server_fd_ < 0) {
-            LOG(ERROR) << "Failed to create metrics socket";
+private:
+    int fourcc_;
+    cv::VideoWriter writer_;
+};
+
+/**
+ * Uncompressed YUV4MPEG2 segments. No encoder at all, so the SDK sees
+ * exactly the decoded ingest frames (at ~1.5 bytes per pixel on disk).
+ */
+class Y4MSegmentWriter : public SegmentWriter {
+public:
+    ~Y4MSegmentWriter() override {
+        release();
+    }
+    
+    bool open(const std::string& path, int fps, cv::Size size) override {
+        if (size.width % 2 || size.height % 2) {
+            LOG(WARNING) << "Y4M needs even dimensions, got " << size.width << "x" << size.height;
             return false;
         }
-        
-        int opt = 1;
-        setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-        
-        struct sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_port = htons(port_);
-        
-        if (bind(server_fd_, (struct sockaddr*)&address, sizeof(address)) < 0) {
-            LOG(ERROR) << "Failed to bind metrics server to port " << port_;
-            close(server_fd_);
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) {
             return false;
         }
-        
-        if (listen(server_fd_, 5) < 0) {
-            LOG(ERROR) << "Failed to listen on metrics socket";
-            close(server_fd_);
-            return false;
-        }
-        
-        running_ = true;
-        server_thread_ = std::thread(&MetricsServer::acceptLoop, this);
-        
-        LOG(INFO) << "Metrics server listening on port " << port_;
+        std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        std::fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", size.width, size.height, fps);
         return true;
     }
     
-    void stop() {
-        running_ = false;
-        if (server_fd_ >= 0) {
-            shutdown(server_fd_, SHUT_RDWR);
-            close(server_fd_);
-            server_fd_ = -1;
+    void write(const cv::Mat& frame) override {
+        if (!file_) {
+            return;
         }
-        if (server_thread_.joinable()) {
-            server_thread_.join();
+        cv::cvtColor(frame, yuv_, cv::COLOR_BGR2YUV_I420);
+        std::fputs("FRAME\n", file_);
+        std::fwrite(yuv_.data, 1, yuv_.total() * yuv_.elemSize(), file_);
+    }
+    
+    void release() override {
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+    
+    bool isOpened() const override { return file_ != nullptr; }
+    
+private:
+    FILE* file_ = nullptr;
+    cv::Mat yuv_;  // Reused I420 conversion target
+};
+
+std::unique_ptr<SegmentWriter> make_segment_writer(RecordingCodec codec) {
+    switch (codec) {
+        case RecordingCodec::kFFV1:
+            return std::make_unique<OpenCVSegmentWriter>(cv::VideoWriter::fourcc('F', 'F', 'V', '1'));
+        case RecordingCodec::kY4M:
+            return std::make_unique<Y4MSegmentWriter>();
+        case RecordingCodec::kH264:
+            return std::make_unique<OpenCVSegmentWriter>(cv::VideoWriter::fourcc('a', 'v', 'c', '1'));
+        case RecordingCodec::kMJPG:
+            break;
+    }
+    return std::make_unique<OpenCVSegmentWriter>(cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+}
+
+/**
+ * What was written for one segment and what it cost; reported with
+ * segment_completed.
+ */
+struct SegmentEncodeStats {
+    RecordingCodec codec = RecordingCodec::kMJPG;
+    size_t frames = 0;
+    double encode_cpu_ms = 0.0;  // Thread CPU time spent inside SegmentWriter::write
+    uint64_t bytes = 0;          // Segment file size after finalize
+    size_t face_samples = 0;     // Frames run through the face detector (0 = not sampled)
+    size_t face_frames = 0;      // Sampled frames with a face
+    size_t quality_screened = 0;  // Frames run through the quality screen (0 = screening off)
+    size_t quality_dropped = 0;   // Screened frames left out of the segment
+    double mean_sharpness = 0.0;
+    double mean_brightness = 0.0;
+    double mean_motion = 0.0;
+    int quality_level = -1;       // Adaptive quality level it was recorded at (-1 = unknown)
+    
+    double faceCoverage() const {
+        return face_samples > 0 ? static_cast<double>(face_frames) / face_samples : 1.0;
+    }
+};
+
+/**
+ * How new segments are recorded relative to the session's nominal settings.
+ * Changed at runtime by the adaptive quality controller.
+ */
+struct QualitySettings {
+    double segment_scale = 1.0;     // Multiplier on the steady segment duration
+    int fps_divisor = 1;            // Keep every Nth frame
+    double resolution_scale = 1.0;  // Multiplier on the session width and height
+    size_t level = 0;               // Adaptive quality level these settings belong to
+};
+
+/**
+ * Sidecar holding a segment's per-frame times (one integer microsecond
+ * offset from the segment's first frame per line), passed to the SDK as
+ * input_video_time_path.
+ */
+std::string segment_timestamps_path(const std::string& video_path) {
+    size_t dot = video_path.find_last_of('.');
+    size_t slash = video_path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return video_path + ".timestamps.txt";
+    }
+    return video_path.substr(0, dot) + ".timestamps.txt";
+}
+
+/**
+ * Sidecar describing how a segment was derived from the source frames
+ * (currently the face crop rectangles).
+ */
+std::string segment_metadata_path(const std::string& video_path) {
+    std::string timestamps = segment_timestamps_path(video_path);
+    return timestamps.substr(0, timestamps.size() - std::strlen(".timestamps.txt")) + ".meta.json";
+}
+
+/**
+ * Every sidecar a segment may have; they live and die with the video file.
+ */
+std::vector<std::string> segment_sidecar_paths(const std::string& video_path) {
+    return {segment_timestamps_path(video_path), segment_metadata_path(video_path)};
+}
+
+/**
+ * Delete a segment file and whichever of its sidecars exist.
+ */
+void remove_segment_files(const std::string& video_path) {
+    unlink(video_path.c_str());
+    for (const auto& sidecar : segment_sidecar_paths(video_path)) {
+        unlink(sidecar.c_str());
+    }
+}
+
+double thread_cpu_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * Parse a segment ramp such as "2,3" or "min,3": lengths in seconds of the
+ * first segments of a session, before the steady segment duration applies.
+ * "min" (stored as 0) sizes a segment by min_segment_frames.
+ */
+std::vector<double> parse_segment_ramp(const std::string& ramp) {
+    std::vector<double> seconds;
+    std::stringstream stream(ramp);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        if (entry == "min") {
+            seconds.push_back(0.0);
+            continue;
+        }
+        try {
+            double value = std::stod(entry);
+            if (value > 0.0) {
+                seconds.push_back(value);
+                continue;
+            }
+        } catch (const std::exception&) {
+        }
+        LOG(WARNING) << "Ignoring invalid segment ramp entry: " << entry;
+    }
+    return seconds;
+}
+
+/**
+ * Cheap face finder for the recording path: a Haar cascade run on a
+ * downscaled, equalized grayscale copy of the frame.
+ */
+class FaceDetector {
+public:
+    bool load(const std::string& cascade_path) {
+        if (!cascade_.load(cascade_path) || cascade_.empty()) {
+            LOG(WARNING) << "Could not load face cascade " << cascade_path;
+            return false;
         }
+        return true;
+    }
+    
+    /**
+     * Find the largest face.
+     * 
+     * @return Its bounding box in frame coordinates, or an empty Rect
+     */
+    cv::Rect detect(const cv::Mat& frame) {
+        double scale = std::min(1.0, static_cast<double>(kDetectWidth) / frame.cols);
+        cv::resize(frame, small_, cv::Size(), scale, scale, cv::INTER_AREA);
+        cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+        cv::equalizeHist(gray_, gray_);
         
-        std::lock_guard<std::mutex> lock(clients_mutex_);
-        for (int fd : client_fds_) {
-            close(fd);
+        std::vector<cv::Rect> faces;
+        cascade_.detectMultiScale(gray_, faces, 1.2, 3, cv::CASCADE_SCALE_IMAGE,
+                                  cv::Size(kMinFaceSize, kMinFaceSize));
+        g_stats.face_detections++;
+        if (faces.empty()) {
+            return cv::Rect();
         }
-        client_fds_.clear();
+        
+        const cv::Rect& face = *std::max_element(faces.begin(), faces.end(),
+            [](const cv::Rect& a, const cv::Rect& b) { return a.area() < b.area(); });
+        return cv::Rect(static_cast<int>(face.x / scale), static_cast<int>(face.y / scale),
+                        static_cast<int>(face.width / scale), static_cast<int>(face.height / scale));
     }
     
-    void broadcast(const std::string& message) {
-        std::lock_guard<std::mutex> lock(clients_mutex_);
-        std::vector<int> disconnected;
+private:
+    static constexpr int kDetectWidth = 240;
+    static constexpr int kMinFaceSize = 24;
+    
+    cv::CascadeClassifier cascade_;
+    cv::Mat small_;
+    cv::Mat gray_;
+};
+
+/**
+ * Image quality of one frame, measured on a small grayscale copy.
+ */
+struct FrameQuality {
+    enum Issue : uint32_t {
+        kBlurry = 1,
+        kUnderexposed = 2,
+        kOverexposed = 4,
+        kMotion = 8,
+    };
+    
+    double sharpness = 0.0;        // Variance of the Laplacian
+    double brightness = 0.0;       // Mean gray level
+    double dark_fraction = 0.0;    // Pixels near black
+    double bright_fraction = 0.0;  // Pixels near white
+    double motion = 0.0;           // Mean absolute difference from the previous frame
+    uint32_t issues = 0;           // Issue bits; 0 = usable
+};
+
+std::vector<std::string> frame_quality_issue_names(uint32_t issues) {
+    std::vector<std::string> names;
+    if (issues & FrameQuality::kBlurry) names.push_back("blurry");
+    if (issues & FrameQuality::kUnderexposed) names.push_back("underexposed");
+    if (issues & FrameQuality::kOverexposed) names.push_back("overexposed");
+    if (issues & FrameQuality::kMotion) names.push_back("motion");
+    return names;
+}
+
+/**
+ * Screens frames for blur, over/under-exposure and motion. Keeps the
+ * previous frame for the motion term, so feed it one session's frames in
+ * order and reset() between sessions.
+ */
+class FrameQualityScreen {
+public:
+    struct Thresholds {
+        double min_sharpness = 20.0;
+        double max_clipped = 0.4;
+        double max_motion = 25.0;
+    };
+    
+    explicit FrameQualityScreen(const Thresholds& thresholds) : thresholds_(thresholds) {}
+    
+    FrameQuality assess(const cv::Mat& frame) {
+        double scale = std::min(1.0, static_cast<double>(kScreenWidth) / frame.cols);
+        cv::resize(frame, small_, cv::Size(), scale, scale, cv::INTER_AREA);
+        cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
         
-        std::string msg_with_newline = message + "\n";
+        FrameQuality quality;
+        cv::Laplacian(gray_, laplacian_, CV_16S);
+        cv::Scalar mean;
+        cv::Scalar stddev;
+        cv::meanStdDev(laplacian_, mean, stddev);
+        quality.sharpness = stddev[0] * stddev[0];
         
-        for (int fd : client_fds_) {
-            ssize_t sent = send(fd, msg_with_newline.c_str(), msg_with_newline.size(), MSG_NOSIGNAL);
-            if (sent < 0) {
-                disconnected.push_back(fd);
+        int channels[] = {0};
+        int bins[] = {256};
+        float range[] = {0.0f, 256.0f};
+        const float* ranges[] = {range};
+        cv::calcHist(&gray_, 1, channels, cv::Mat(), hist_, 1, bins, ranges);
+        double total = static_cast<double>(gray_.total());
+        double level_sum = 0.0;
+        double dark = 0.0;
+        double bright = 0.0;
+        for (int level = 0; level < 256; ++level) {
+            double count = hist_.at<float>(level, 0);
+            level_sum += level * count;
+            if (level < kDarkLevel) {
+                dark += count;
+            } else if (level > kBrightLevel) {
+                bright += count;
             }
         }
+        quality.brightness = level_sum / total;
+        quality.dark_fraction = dark / total;
+        quality.bright_fraction = bright / total;
         
-        for (int fd : disconnected) {
-            close(fd);
-            client_fds_.erase(fd);
-            LOG(INFO) << "Metrics client disconnected";
+        if (!previous_.empty() && previous_.size() == gray_.size()) {
+            cv::absdiff(gray_, previous_, diff_);
+            quality.motion = cv::mean(diff_)[0];
         }
+        std::swap(previous_, gray_);
+        
+        if (quality.sharpness < thresholds_.min_sharpness) quality.issues |= FrameQuality::kBlurry;
+        if (quality.dark_fraction > thresholds_.max_clipped) quality.issues |= FrameQuality::kUnderexposed;
+        if (quality.bright_fraction > thresholds_.max_clipped) quality.issues |= FrameQuality::kOverexposed;
+        if (quality.motion > thresholds_.max_motion) quality.issues |= FrameQuality::kMotion;
+        return quality;
     }
     
-    bool hasClients() {
-        std::lock_guard<std::mutex> lock(clients_mutex_);
-        return !client_fds_.empty();
+    void reset() {
+        previous_.release();
     }
     
 private:
-    void acceptLoop() {
-        while (running_ && g_running) {
-            fd_set readfds;
-            FD_ZERO(&readfds);
-            FD_SET(server_fd_, &readfds);
-            
-            struct timeval tv;
-            tv.tv_sec = 1;
-            tv.tv_usec = 0;
-            
-            int activity = select(server_fd_ + 1, &readfds, NULL, NULL, &tv);
-            
-            if (activity < 0 && errno != EINTR) {
-                continue;
-            }
-            
-            if (activity > 0 && FD_ISSET(server_fd_, &readfds)) {
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                int client_fd = accept(server_fd_, (struct sockaddr*)&client_addr, &client_len);
-                
-                if (client_fd >= 0) {
-                    std::lock_guard<std::mutex> lock(clients_mutex_);
-                    client_fds_.insert(client_fd);
-                    LOG(INFO) << "Metrics client connected from " << inet_ntoa(client_addr.sin_addr);
-                }
-            }
-        }
-    }
+    static constexpr int kScreenWidth = 320;
+    static constexpr int kDarkLevel = 16;
+    static constexpr int kBrightLevel = 239;
     
-    int port_;
-    int server_fd_;
-    std::atomic<bool> running_;
-    std::thread server_thread_;
-    std::mutex clients_mutex_;
-    std::set<int> client_fds_;
+    Thresholds thresholds_;
+    cv::Mat small_;
+    cv::Mat gray_;
+    cv::Mat previous_;
+    cv::Mat laplacian_;
+    cv::Mat diff_;
+    cv::Mat hist_;
 };
 
 // ============================================================================
-// SDK Video Processor - Processes recorded video files with SmartSpectra SDK
+// Session Recorder - Records video frames with real-time segment processing
 // ============================================================================
 
-using namespace presage::smartspectra;
-
-/**
- * SDKVideoProcessor runs the SmartSpectra SDK on recorded video files
- * and broadcasts the resulting metrics via the MetricsServer.
- * 
- * Supports processing video segments in a queue for real-time metrics.
- * Processing happens in background threads so it doesn't block
- * the video input server from accepting new sessions.
- */
-class SDKVideoProcessor {
+class SessionRecorder {
 public:
-    struct ProcessingJob {
-        std::string video_path;
-        std::string session_id;
-        size_t segment_index;
-        bool is_segment;  // true for segments, false for final processing
-    };
+    // Segment processing callback type
+    using SegmentReadyCallback = std::function<void(const std::string& video_path, 
+                                                     const std::string& session_id,
+                                                     size_t segment_index,
+                                                     const PipelineTimestamps& timestamps,
+                                                     const SegmentEncodeStats& encode_stats)>;
+    // Receives quality_feedback messages for the connected video client;
+    // returns false if the message was dropped
+    using QualityFeedbackCallback = std::function<bool(const json& message)>;
 
-    SDKVideoProcessor(const std::string& api_key, int frame_width, int frame_height)
-        : api_key_(api_key), frame_width_(frame_width), frame_height_(frame_height),
-          processing_(false), shutdown_(false) {
-        // Start worker thread for processing queue
-        worker_thread_ = std::thread(&SDKVideoProcessor::processingWorker, this);
+    SessionRecorder(const std::string& recordings_dir, int default_fps = 30, 
+                    int segment_duration_seconds = 5)
+        : recordings_dir_(recordings_dir), default_fps_(default_fps), 
+          segment_duration_seconds_(segment_duration_seconds), recording_(false),
+          total_frame_count_(0), current_segment_index_(0) {
+        // Create recordings directory if it doesn't exist
+        createDirectory(recordings_dir_);
     }
     
-    ~SDKVideoProcessor() {
-        shutdown();
+    ~SessionRecorder() {
+        stopRecording();
     }
     
     /**
-     * Shutdown the processor and wait for pending jobs.
+     * Set callback for when a segment is ready for processing.
+     * This enables real-time processing of video segments.
      */
-    void shutdown() {
-        {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            shutdown_ = true;
-        }
-        queue_cv_.notify_all();
-        
-        if (worker_thread_.joinable()) {
-            worker_thread_.join();
-        }
+    void setSegmentReadyCallback(SegmentReadyCallback callback) {
+        segment_ready_callback_ = callback;
     }
     
     /**
-     * Queue a video segment for processing.
-     * Used for real-time segment processing during a session.
-     * 
-     * @param video_path Path to the segment video file
-     * @param session_id Session identifier
-     * @param segment_index Segment index within the session
+     * Set the codec used when a session doesn't pick one.
      */
-    void queueSegment(const std::string& video_path, const std::string& session_id, 
-                      size_t segment_index) {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        
-        ProcessingJob job;
-        job.video_path = video_path;
-        job.session_id = session_id;
-        job.segment_index = segment_index;
-        job.is_segment = true;
-        
-        processing_queue_.push(job);
-        
-        LOG(INFO) << "Queued segment " << segment_index << " for session " << session_id
-                  << " (queue size: " << processing_queue_.size() << ")";
-        
-        queue_cv_.notify_one();
+    void setDefaultCodec(RecordingCodec codec) {
+        default_codec_ = codec;
     }
     
     /**
-     * Process a recorded video file using the SmartSpectra SDK.
-     * Runs in a background thread.
+     * Start sessions with shorter segments so the first metrics arrive sooner.
      * 
-     * @param video_path Path to the recorded video file
-     * @param session_id Session identifier for logging
-     * @return true if processing was started, false if already processing
+     * @param ramp_seconds Lengths of the leading segments (0 = min_segment_frames)
+     * @param min_segment_frames Floor for ramp segments, so none is too short for the SDK
      */
-    bool processVideoAsync(const std::string& video_path, const std::string& session_id) {
-        // Check if already processing
-        if (processing_.load()) {
-            LOG(WARNING) << "SDK already processing another video";
-            return false;
-        }
-        
-        // Wait for any previous processing thread to complete
-        waitForCompletion();
-        
-        // Start new processing thread
-        processing_ = true;
-        current_session_id_ = session_id;
-        
-        processing_thread_ = std::thread(&SDKVideoProcessor::processVideo, this, 
-                                         video_path, session_id);
-        
-        LOG(INFO) << "Started SDK processing for session " << session_id 
-                  << " in background thread";
-        return true;
+    void setSegmentRamp(std::vector<double> ramp_seconds, size_t min_segment_frames) {
+        default_ramp_seconds_ = std::move(ramp_seconds);
+        min_segment_frames_ = min_segment_frames;
     }
     
     /**
-     * Check if SDK processing is currently in progress.
+     * Record each frame's real time alongside the segment instead of relying
+     * on the nominal session fps.
      */
-    bool isProcessing() const {
-        return processing_.load();
+    void setWriteFrameTimestamps(bool enabled) {
+        write_frame_timestamps_ = enabled;
     }
     
     /**
-     * Get the current session being processed.
+     * Sample every Nth recorded frame for a face, so each segment reports
+     * its face coverage.
      */
-    std::string getCurrentSessionId() const {
-        return current_session_id_;
+    void setFaceDetector(std::unique_ptr<FaceDetector> detector, int interval) {
+        face_detector_ = std::move(detector);
+        face_detect_interval_ = static_cast<size_t>(std::max(1, interval));
     }
     
     /**
-     * Wait for the current processing to complete.
+     * Record a square around the face instead of the whole frame. The box
+     * follows the sampled face detections with smoothing, and holds its
+     * place while the face is lost. Needs a face detector.
+     * 
+     * @param output_size Side length of the recorded frames
+     * @param padding Margin on each side of the face, as a fraction of its width
      */
-    void waitForCompletion() {
-        if (processing_thread_.joinable()) {
-            processing_thread_.join();
-        }
+    void setFaceCrop(int output_size, double padding) {
+        int side = std::max(2, output_size & ~1);
+        crop_size_ = cv::Size(side, side);
+        crop_padding_ = std::max(0.0, padding);
     }
     
-private:
     /**
-     * Worker thread that processes queued video segments.
+     * Screen each frame for blur, exposure and motion. Frames that fail are
+     * left out of the recording; about once a second the client is told
+     * what is wrong through the feedback callback.
      */
-    void processingWorker() {
-        LOG(INFO) << "SDK processing worker started";
-        
-        while (true) {
-            ProcessingJob job;
-            
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex_);
-                
-                // Wait for a job or shutdown
-                queue_cv_.wait(lock, [this]() {
-                    return shutdown_ || !processing_queue_.empty();
-                });
-                
-                if (shutdown_ && processing_queue_.empty()) {
-                    break;
-                }
-                
-                if (processing_queue_.empty()) {
-                    continue;
-                }
-                
-                job = processing_queue_.front();
-                processing_queue_.pop();
-            }
-            
-            // Process the segment
-            LOG(INFO) << "Processing segment " << job.segment_index 
-                      << " for session " << job.session_id;
-            
-            processVideoSegment(job.video_path, job.session_id, job.segment_index);
-        }
-        
-        LOG(INFO) << "SDK processing worker stopped";
+    void setQualityScreen(const FrameQualityScreen::Thresholds& thresholds, QualityFeedbackCallback feedback) {
+        quality_screen_ = std::make_unique<FrameQualityScreen>(thresholds);
+        quality_feedback_callback_ = std::move(feedback);
     }
     
     /**
-     * Process a video segment and emit metrics.
-     * Optimized for quick turnaround on short segments.
+     * Rotate through these codecs segment by segment, overriding the session
+     * codec, so their cost and SDK confidence can be compared on live input.
      */
-    void processVideoSegment(const std::string& video_path, const std::string& session_id,
-                             size_t segment_index) {
-        LOG(INFO) << "SDK segment processing started for: " << video_path;
+    void setBenchmarkCodecs(std::vector<RecordingCodec> codecs) {
+        benchmark_codecs_ = std::move(codecs);
+    }
+    
+    /**
+     * Change segment length, fps and resolution. Takes effect from the next
+     * segment so a segment file never mixes settings.
+     */
+    void setQualitySettings(const QualitySettings& quality) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quality_ = quality;
+    }
+    
+    /**
+     * Start a new recording session with real-time segment processing.
+     * 
+     * @param session_id Unique session identifier (used in filename)
+     * @param fps Frame rate for the video (default: 30)
+     * @param width Frame width (0 = auto-detect from first frame)
+     * @param height Frame height (0 = auto-detect from first frame)
+     * @param codec Recording codec (nullptr = deployment default)
+     * @param ramp_seconds Leading segment lengths (nullptr = deployment default)
+     * @return true if session started successfully
+     */
+    bool startSession(const std::string& session_id, int fps = 0, int width = 0, int height = 0,
+                      const RecordingCodec* codec = nullptr,
+                      const std::vector<double>* ramp_seconds = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
         
-        // Broadcast processing start status
-        if (g_metrics_server) {
-            json status_msg;
-            status_msg["type"] = "sdk_status";
-            status_msg["status"] = "segment_processing";
-            status_msg["session_id"] = session_id;
-            status_msg["segment_index"] = segment_index;
-            status_msg["video_path"] = video_path;
-            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count();
-            g_metrics_server->broadcast(status_msg.dump());
+        if (recording_) {
+            LOG(WARNING) << "Recording already in progress for session " << current_session_id_;
+            return false;
         }
         
-        try {
-            // Create SDK settings (reuse common setup)
-            container::settings::Settings<
-                container::settings::OperationMode::Continuous,
-                container::settings::IntegrationMode::Rest
-            > settings;
-            
-            // Configure video source for file input
-            settings.video_source.input_video_path = video_path;
-            settings.video_source.device_index = -1;  // Disable camera, use file
-            settings.video_source.capture_width_px = frame_width_;
-            settings.video_source.capture_height_px = frame_height_;
-            settings.video_source.codec = presage::camera::CaptureCodec::MJPG;
-            settings.video_source.auto_lock = true;
-            
-            // SDK configuration
-            settings.headless = true;  // No GUI
-            settings.enable_edge_metrics = true;
-            settings.verbosity_level = 0;  // Reduce logging for segments
-            settings.continuous.preprocessed_data_buffer_duration_s = 0.25;  // Reduced for faster initial metrics
-            settings.integration.api_key = api_key_;
-            
-            // Create SDK container
-            auto container = std::make_unique<container::CpuContinuousRestForegroundContainer>(settings);
-            
-            // Track metrics count for this segment
-            size_t metrics_count = 0;
-            
-            // Register metrics callback
-            auto metrics_status = container->SetOnCoreMetricsOutput(
-                [this, session_id, segment_index, &metrics_count](
-                    const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
-                    // Convert SDK metrics to our JSON format and broadcast
-                    std::string json_str = sdkMetricsToJson(metrics, timestamp, session_id);
-                    
-                    // Add segment info to the JSON
-                    json j = json::parse(json_str);
-                    j["segment_index"] = segment_index;
-                    j["realtime"] = true;  // Flag to indicate this is real-time data
-                    
-                    if (g_metrics_server) {
-                        g_metrics_server->broadcast(j.dump());
-                    }
-                    
-                    metrics_count++;
-                    
-                    return absl::OkStatus();
-                }
-            );
-            
-            if (!metrics_status.ok()) {
-                LOG(ERROR) << "Failed to set SDK metrics callback: " << metrics_status.message();
-                return;
-            }
-            
-            // Initialize and run SDK (blocking until video ends)
-            if (auto init_status = container->Initialize(); !init_status.ok()) {
-                LOG(ERROR) << "Failed to initialize SDK for segment: " << init_status.message();
-                return;
-            }
-            
-            if (auto run_status = container->Run(); !run_status.ok()) {
-                if (!absl::IsCancelled(run_status)) {
-                    LOG(ERROR) << "SDK segment processing error: " << run_status.message();
-                }
-            }
-            
-            LOG(INFO) << "SDK segment " << segment_index << " completed"
-                      << " - " << metrics_count << " metrics generated";
-            
-            // Optionally delete processed segment file to save space
-            // std::remove(video_path.c_str());
-            
-        } catch (const std::exception& e) {
-            LOG(ERROR) << "SDK segment processing exception: " << e.what();
+        current_session_id_ = session_id;
+        session_fps_ = (fps > 0) ? fps : default_fps_;
+        session_width_ = width;
+        session_height_ = height;
+        session_codec_ = codec ? *codec : default_codec_;
+        
+        // Calculate frames per segment; leading segments follow the ramp
+        steady_frames_per_segment_ = session_fps_ * segment_duration_seconds_;
+        session_ramp_frames_.clear();
+        for (double seconds : ramp_seconds ? *ramp_seconds : default_ramp_seconds_) {
+            size_t frames = seconds > 0.0 ? static_cast<size_t>(std::ceil(seconds * session_fps_)) : 0;
+            session_ramp_frames_.push_back(std::max(frames, min_segment_frames_));
         }
-    }
-    void processVideo(const std::string& video_path, const std::string& session_id) {
-        LOG(INFO) << "SDK processing started for: " << video_path;
         
-        // Broadcast processing start status
-        if (g_metrics_server) {
-            json status_msg;
-            status_msg["type"] = "sdk_status";
-            status_msg["status"] = "processing_started";
-            status_msg["session_id"] = session_id;
-            status_msg["video_path"] = video_path;
-            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count();
-            g_metrics_server->broadcast(status_msg.dump());
+        recording_ = true;
+        total_frame_count_ = 0;
+        segment_frame_count_ = 0;
+        current_segment_index_ = 0;
+        if (quality_screen_) {
+            quality_screen_->reset();
         }
+        feedback_window_ = FeedbackWindow{};
+        last_feedback_issues_ = 0;
+        crop_tracking_ = false;
         
-        try {
-            // Create SDK settings
-            container::settings::Settings<
-                container::settings::OperationMode::Continuous,
-                container::settings::IntegrationMode::Rest
-            > settings;
-            
-            // Configure video source for file input
-            settings.video_source.input_video_path = video_path;
-            settings.video_source.device_index = -1;  // Disable camera, use file
-            settings.video_source.capture_width_px = frame_width_;
-            settings.video_source.capture_height_px = frame_height_;
-            settings.video_source.codec = presage::camera::CaptureCodec::MJPG;
-            settings.video_source.auto_lock = true;
-            
-            // SDK configuration
-            settings.headless = true;  // No GUI
-            settings.enable_edge_metrics = true;
-            settings.verbosity_level = 1;
-            settings.continuous.preprocessed_data_buffer_duration_s = 0.5;
-            settings.integration.api_key = api_key_;
-            
-            // Create SDK container
-            auto container = std::make_unique<container::CpuContinuousRestForegroundContainer>(settings);
-            
-            // Track metrics count for this session
-            size_t metrics_count = 0;
-            
-            // Register metrics callback
-            auto metrics_status = container->SetOnCoreMetricsOutput(
-                [this, session_id, &metrics_count](const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
-                    // Convert SDK metrics to our JSON format and broadcast
-                    std::string json_str = sdkMetricsToJson(metrics, timestamp, session_id);
-                    
-                    if (g_metrics_server) {
-                        g_metrics_server->broadcast(json_str);
-                    }
-                    
-                    metrics_count++;
-                    
-                    // Log periodically
-                    if (metrics_count % 10 == 0) {
-                        LOG(INFO) << "SDK metrics broadcast #" << metrics_count 
-                                  << " for session " << session_id;
-                    }
-                    
-                    return absl::OkStatus();
-                }
-            );
-            
-            if (!metrics_status.ok()) {
-                LOG(ERROR) << "Failed to set SDK metrics callback: " << metrics_status.message();
-                broadcastError(session_id, "Failed to set metrics callback");
-                processing_ = false;
-                return;
-            }
-            
-            // Register status callback
-            container->SetOnStatusChange(
-                [this, session_id](presage::physiology::StatusValue imaging_status) {
-                    std::string status_desc = presage::physiology::GetStatusDescription(imaging_status.value());
-                    LOG(INFO) << "SDK Status [" << session_id << "]: " << status_desc;
-                    
-                    // Broadcast status changes
-                    if (g_metrics_server) {
-                        json status_msg;
-                        status_msg["type"] = "sdk_imaging_status";
-                        status_msg["session_id"] = session_id;
-                        status_msg["status"] = status_desc;
-                        status_msg["status_code"] = static_cast<int>(imaging_status.value());
-                        status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                            std::chrono::system_clock::now().time_since_epoch()).count();
-                        g_metrics_server->broadcast(status_msg.dump());
-                    }
-                    
-                    return absl::OkStatus();
-                }
-            );
-            
-            // Initialize SDK
-            LOG(INFO) << "Initializing SDK for video: " << video_path;
-            if (auto init_status = container->Initialize(); !init_status.ok()) {
-                LOG(ERROR) << "Failed to initialize SDK: " << init_status.message();
-                broadcastError(session_id, "SDK initialization failed: " + std::string(init_status.message()));
-                processing_ = false;
-                return;
-            }
-            
-            LOG(INFO) << "SDK initialized, starting video processing...";
-            
-            // Run processing (blocks until video ends)
-            if (auto run_status = container->Run(); !run_status.ok()) {
-                // CancelledError is normal when video ends
-                if (!absl::IsCancelled(run_status)) {
-                    LOG(ERROR) << "SDK processing error: " << run_status.message();
-                    broadcastError(session_id, "SDK processing error: " + std::string(run_status.message()));
-                }
-            }
-            
-            LOG(INFO) << "SDK processing completed for session " << session_id 
-                      << " - " << metrics_count << " metrics generated";
-            
-            // Broadcast completion status
-            if (g_metrics_server) {
-                json status_msg;
-                status_msg["type"] = "sdk_status";
-                status_msg["status"] = "processing_completed";
-                status_msg["session_id"] = session_id;
-                status_msg["metrics_count"] = metrics_count;
-                status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now().time_since_epoch()).count();
-                g_metrics_server->broadcast(status_msg.dump());
+        // Start first segment
+        startNewSegment();
+        
+        LOG(INFO) << "Started recording session " << session_id 
+                  << " at " << session_fps_ << " fps"
+                  << " with " << segment_duration_seconds_ << "s segments ("
+                  << steady_frames_per_segment_ << " frames/segment, "
+                  << session_ramp_frames_.size() << " ramp segments)";
+        
+        return true;
+    }
+    
+    /**
+     * Add a frame to the current recording.
+     * Automatically creates new segments and triggers processing.
+     * 
+     * @param frame The frame to record (BGR format)
+     * @param received_at When the frame's bytes finished arriving on the socket
+     * @param capture_us Client capture time in microseconds, or -1 if the client sent none
+     * @return true if frame was recorded successfully
+     */
+    bool addFrame(const cv::Mat& frame,
+                  PipelineTimestamps::Clock::time_point received_at = PipelineTimestamps::Clock::now(),
+                  int64_t capture_us = -1) {
+        bool recorded;
+        std::vector<json> feedback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recorded = addFrameLocked(frame, received_at, capture_us);
+            feedback.swap(pending_feedback_);
+        }
+        // Sent outside mutex_ so a slow video client never holds up recording
+        for (const json& message : feedback) {
+            if (quality_feedback_callback_(message)) {
+                g_stats.quality_feedback_sent++;
+            } else {
+                g_stats.quality_feedback_dropped++;
             }
-            
-        } catch (const std::exception& e) {
-            LOG(ERROR) << "SDK processing exception: " << e.what();
-            broadcastError(session_id, std::string("SDK exception: ") + e.what());
         }
-        
-        processing_ = false;
-        current_session_id_.clear();
+        return recorded;
     }
     
     /**
-     * Convert SDK MetricsBuffer to our extended JSON format.
+     * Stop the current recording session.
+     * Finalizes any remaining segment.
+     * 
+     * @return Path to the final segment video file, or empty string if no recording was active
      */
-    std::string sdkMetricsToJson(const presage::physiology::MetricsBuffer& metrics, 
-                                  int64_t timestamp, const std::string& session_id) {
-        json j;
-        j["type"] = "metrics";
-        j["source"] = "presage_sdk";
-        j["session_id"] = session_id;
-        j["timestamp"] = timestamp;
-        
-        // =====================================================================
-        // PULSE METRICS
-        // =====================================================================
+    std::string stopRecording() {
+        std::lock_guard<std::mutex> lock(mutex_);
         
-        // Extract pulse rate from the most recent rate measurement
-        float pulse_rate = 0.0f;
-        float pulse_confidence = 0.0f;
-        if (metrics.pulse().rate_size() > 0) {
-            // Get the last (most recent) rate measurement
-            const auto& last_rate = metrics.pulse().rate(metrics.pulse().rate_size() - 1);
-            pulse_rate = last_rate.value();
-            pulse_confidence = last_rate.confidence();
-        } else if (metrics.has_pulse() && metrics.pulse().has_strict()) {
-            // Fallback to strict value if rate array is empty
-            pulse_rate = metrics.pulse().strict().value();
+        if (!recording_) {
+            return "";
         }
-        j["pulse_rate"] = pulse_rate;
-        j["pulse_confidence"] = pulse_confidence;
         
-        // Extract full pulse trace for HRV calculation (PPG signal)
-        // Format: [[time1, value1], [time2, value2], ...]
-        json trace_array = json::array();
-        for (int i = 0; i < metrics.pulse().trace_size(); ++i) {
-            const auto& trace_point = metrics.pulse().trace(i);
-            trace_array.push_back({trace_point.time(), trace_point.value()});
+        recording_ = false;
+        
+        // Finalize current segment if it has frames
+        std::string final_path = "";
+        if (segment_frame_count_ > 0 && writerOpen()) {
+            final_path = finalizeCurrentSegmentLocked();
         }
-        j["pulse_trace"] = trace_array;
         
-        // =====================================================================
-        // BREATHING METRICS
-        // =====================================================================
+        LOG(INFO) << "Stopped recording session " << current_session_id_ 
+                  << " - " << total_frame_count_ << " total frames"
+                  << " across " << (current_segment_index_ + 1) << " segments";
         
-        // Extract breathing rate from the most recent rate measurement
-        float breathing_rate = 0.0f;
-        float breathing_confidence = 0.0f;
-        if (metrics.breathing().rate_size() > 0) {
-            // Get the last (most recent) rate measurement
-            const auto& last_rate = metrics.breathing().rate(metrics.breathing().rate_size() - 1);
-            breathing_rate = last_rate.value();
-            breathing_confidence = last_rate.confidence();
+        // Reset state
+        current_session_id_.clear();
+        current_video_path_.clear();
+        total_frame_count_ = 0;
+        segment_frame_count_ = 0;
+        current_segment_index_ = 0;
+        
+        return final_path;
+    }
+    
+    /**
+     * Check if a recording is currently active.
+     */
+    bool isRecording() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return recording_;
+    }
+    
+    /**
+     * Get the current session ID.
+     */
+    std::string getCurrentSessionId() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return current_session_id_;
+    }
+    
+    /**
+     * Get the current video file path.
+     */
+    std::string getCurrentVideoPath() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return current_video_path_;
+    }
+    
+    /**
+     * Get the total number of frames recorded in the current session.
+     */
+    size_t getFrameCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return total_frame_count_;
+    }
+    
+    /**
+     * Get the recordings directory path.
+     */
+    std::string getRecordingsDir() const {
+        return recordings_dir_;
+    }
+    
+    /**
+     * Get segment duration in seconds.
+     */
+    int getSegmentDuration() const {
+        return segment_duration_seconds_;
+    }
+    
+    /**
+     * Get the resolution frames are recorded at (empty until known).
+     * Lets upstream stages resize before addFrame so it doesn't have to.
+     */
+    cv::Size getFrameSize() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!recording_ || segment_width_ <= 0 || segment_height_ <= 0) {
+            return cv::Size();
+        }
+        if (!crop_size_.empty()) {
+            return cv::Size();  // The crop needs full frames
+        }
+        return cv::Size(segment_width_, segment_height_);
+    }
+    
+    /**
+     * Frame counts of the current session's ramp segments, then the steady count.
+     */
+    std::vector<size_t> getSegmentPlan() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<size_t> plan = session_ramp_frames_;
+        plan.push_back(steady_frames_per_segment_);
+        return plan;
+    }
+    
+    /**
+     * Codec of the current session's recordings (first segment's, when benchmarking).
+     */
+    RecordingCodec getSessionCodec() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return benchmark_codecs_.empty() ? session_codec_ : benchmark_codecs_.front();
+    }
+    
+private:
+    bool writerOpen() const {
+        return writer_ && writer_->isOpened();
+    }
+    
+    /**
+     * addFrame with mutex_ held. Quality feedback is queued in
+     * pending_feedback_ for the caller to send once the lock is released.
+     */
+    bool addFrameLocked(const cv::Mat& frame,
+                        PipelineTimestamps::Clock::time_point received_at,
+                        int64_t capture_us) {
+        if (!recording_) {
+            return false;
+        }
+        
+        if (frame.empty()) {
+            LOG(WARNING) << "Attempted to record empty frame";
+            return false;
+        }
+        
+        // Reduced fps: the frame time sidecar keeps the kept frames' real spacing
+        if (segment_quality_.fps_divisor > 1 && decimation_counter_++ % segment_quality_.fps_divisor != 0) {
+            g_stats.frames_decimated++;
+            return true;
+        }
+        
+        if (quality_screen_) {
+            FrameQuality quality;
+            {
+                TraceSpan span("quality_screen");
+                quality = quality_screen_->assess(frame);
+            }
+            noteFrameQuality(quality);
+            if (quality.issues != 0) {
+                g_stats.frames_dropped_quality++;
+                return true;
+            }
+        }
+        
+        // Initialize writer on first frame if dimensions weren't specified
+        if (!writerOpen()) {
+            if (!initializeWriter(frame.cols, frame.rows)) {
+                recording_ = false;
+                return false;
+            }
+        }
+        
+        // Faces are found on the full frame, so the crop can follow them
+        cv::Rect face;
+        if (face_detector_ && segment_frame_count_ % face_detect_interval_ == 0) {
+            TraceSpan span("face_detect");
+            encode_stats_.face_samples++;
+            face = face_detector_->detect(frame);
+            if (!face.empty()) {
+                encode_stats_.face_frames++;
+            }
+        }
+        cv::Mat source = frame;
+        if (!crop_size_.empty()) {
+            source = frame(updateCropRect(frame.size(), face));
+        }
+        
+        // Resize frame if it doesn't match expected dimensions. The target is a
+        // member so its storage is reused across frames of the session.
+        cv::Mat frame_to_write;
+        if (source.cols != segment_width_ || source.rows != segment_height_) {
+            TraceSpan span("resize");
+            const uint8_t* previous = resize_buffer_.data;
+            cv::resize(source, resize_buffer_, cv::Size(segment_width_, segment_height_), 0, 0, cv::INTER_AREA);
+            if (resize_buffer_.data != previous) {
+                g_stats.resize_allocations++;
+            }
+            frame_to_write = resize_buffer_;
+            g_stats.frames_resized++;
+        } else {
+            frame_to_write = source;
+        }
+        
+        {
+            TraceSpan span("write");
+            double cpu_started = thread_cpu_ms();
+            writer_->write(frame_to_write);
+            encode_stats_.encode_cpu_ms += thread_cpu_ms() - cpu_started;
+        }
+        if (write_frame_timestamps_) {
+            segment_frame_times_us_.push_back(frameTimeUs(received_at, capture_us));
+        }
+        total_frame_count_++;
+        segment_frame_count_++;
+        
+        if (segment_frame_count_ == 1) {
+            segment_timestamps_.first_frame_received = received_at;
+        }
+        segment_timestamps_.last_frame_received = received_at;
+        
+        // Check if segment is complete
+        if (segment_frame_count_ >= frames_per_segment_) {
+            finalizeCurrentSegment();
+            startNewSegment();
+        }
+        
+        return true;
+    }
+    
+    /**
+     * Fold a screened frame into the segment's quality stats and the
+     * feedback window. A window covers about a second of frames; an issue
+     * is reported when it hit at least half of them. Feedback is queued
+     * when the reported issues change, and repeated every few windows while
+     * they persist.
+     */
+    void noteFrameQuality(const FrameQuality& quality) {
+        SegmentEncodeStats& stats = encode_stats_;
+        stats.quality_screened++;
+        double n = static_cast<double>(stats.quality_screened);
+        stats.mean_sharpness += (quality.sharpness - stats.mean_sharpness) / n;
+        stats.mean_brightness += (quality.brightness - stats.mean_brightness) / n;
+        stats.mean_motion += (quality.motion - stats.mean_motion) / n;
+        if (quality.issues != 0) {
+            stats.quality_dropped++;
+        }
+        
+        FeedbackWindow& window = feedback_window_;
+        window.frames++;
+        window.dropped += quality.issues != 0 ? 1 : 0;
+        window.sharpness_sum += quality.sharpness;
+        window.brightness_sum += quality.brightness;
+        window.motion_sum += quality.motion;
+        for (int bit = 0; bit < 4; ++bit) {
+            if (quality.issues & (1u << bit)) {
+                window.issue_counts[bit]++;
+            }
+        }
+        if (window.frames < static_cast<size_t>(std::max(1, session_fps_))) {
+            return;
+        }
+        
+        uint32_t issues = 0;
+        for (int bit = 0; bit < 4; ++bit) {
+            if (window.issue_counts[bit] * 2 >= window.frames) {
+                issues |= 1u << bit;
+            }
+        }
+        bool send = issues != last_feedback_issues_ ||
+                    (issues != 0 && ++windows_since_feedback_ >= kFeedbackRepeatWindows);
+        if (send && quality_feedback_callback_) {
+            json message;
+            message["type"] = "quality_feedback";
+            message["session_id"] = current_session_id_;
+            message["status"] = issues != 0 ? "poor" : "ok";
+            message["issues"] = frame_quality_issue_names(issues);
+            message["dropped_fraction"] = static_cast<double>(window.dropped) / window.frames;
+            message["sharpness"] = window.sharpness_sum / window.frames;
+            message["brightness"] = window.brightness_sum / window.frames;
+            message["motion"] = window.motion_sum / window.frames;
+            message["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            pending_feedback_.push_back(std::move(message));
+        }
+        if (send) {
+            last_feedback_issues_ = issues;
+            windows_since_feedback_ = 0;
+        }
+        feedback_window_ = FeedbackWindow{};
+    }
+    
+    /**
+     * Pick a frame's time on the session clock. The first frame decides the
+     * clock: client capture times if it carried one, arrival times otherwise.
+     * On the client clock, frames without a capture time are extrapolated by
+     * their arrival gap. Times are forced strictly increasing.
+     */
+    int64_t frameTimeUs(PipelineTimestamps::Clock::time_point received_at, int64_t capture_us) {
+        int64_t arrival_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            received_at.time_since_epoch()).count();
+        if (total_frame_count_ == 0) {
+            client_clock_ = capture_us >= 0;
+        }
+        
+        int64_t time_us;
+        if (!client_clock_) {
+            time_us = arrival_us;
+        } else if (capture_us >= 0) {
+            time_us = capture_us;
+        } else {
+            time_us = last_frame_time_us_ + (arrival_us - last_arrival_us_);
+        }
+        if (total_frame_count_ > 0 && time_us <= last_frame_time_us_) {
+            time_us = last_frame_time_us_ + 1;
+        }
+        
+        last_frame_time_us_ = time_us;
+        last_arrival_us_ = arrival_us;
+        return time_us;
+    }
+    
+    /**
+     * Fold a new face detection (if any) into the crop target and return the
+     * rectangle to record. Detections that stay within a deadband of the
+     * target are treated as noise. The box glides a step toward the target
+     * on every frame, so it moves smoothly between sampled detections. It
+     * keeps the output's aspect ratio and stays inside the frame. Before
+     * the first face of a session it is the largest centered box. Changes
+     * are logged for the metadata sidecar.
+     */
+    cv::Rect updateCropRect(cv::Size frame_size, const cv::Rect& face) {
+        double aspect = static_cast<double>(crop_size_.width) / crop_size_.height;
+        double padded = 1.0 + 2.0 * crop_padding_;
+        
+        if (!face.empty()) {
+            double cx = face.x + face.width / 2.0;
+            double cy = face.y + face.height / 2.0;
+            if (!crop_tracking_) {
+                // Glide in from the centered box rather than jumping to the face
+                crop_cx_ = frame_size.width / 2.0;
+                crop_cy_ = frame_size.height / 2.0;
+                crop_face_width_ = frame_size.height * aspect / padded;
+                crop_target_cx_ = cx;
+                crop_target_cy_ = cy;
+                crop_target_width_ = face.width;
+                crop_tracking_ = true;
+            } else {
+                double band = kCropDeadband * crop_target_width_;
+                if (std::abs(cx - crop_target_cx_) > band || std::abs(cy - crop_target_cy_) > band ||
+                    std::abs(face.width - crop_target_width_) > band) {
+                    crop_target_cx_ += kCropSmoothing * (cx - crop_target_cx_);
+                    crop_target_cy_ += kCropSmoothing * (cy - crop_target_cy_);
+                    crop_target_width_ += kCropSmoothing * (face.width - crop_target_width_);
+                }
+            }
+        }
+        if (crop_tracking_) {
+            auto glide = [](double& value, double target) {
+                value = std::abs(target - value) < 0.5 ? target : value + kCropFollow * (target - value);
+            };
+            glide(crop_cx_, crop_target_cx_);
+            glide(crop_cy_, crop_target_cy_);
+            glide(crop_face_width_, crop_target_width_);
+        }
+        
+        double cx = frame_size.width / 2.0;
+        double cy = frame_size.height / 2.0;
+        double width = frame_size.height * aspect;
+        if (crop_tracking_) {
+            cx = crop_cx_;
+            cy = crop_cy_;
+            width = crop_face_width_ * padded;
+        }
+        double height = width / aspect;
+        double fit = std::min({1.0, frame_size.width / width, frame_size.height / height});
+        int w = std::max(2, static_cast<int>(width * fit));
+        int h = std::max(2, static_cast<int>(height * fit));
+        int x = std::clamp(static_cast<int>(std::lround(cx - w / 2.0)), 0, frame_size.width - w);
+        int y = std::clamp(static_cast<int>(std::lround(cy - h / 2.0)), 0, frame_size.height - h);
+        cv::Rect rect(x, y, w, h);
+        
+        if (segment_crops_.empty() || rect != crop_rect_) {
+            segment_crops_.push_back({{"frame", segment_frame_count_}, {"x", x}, {"y", y},
+                                      {"width", w}, {"height", h}});
+            crop_rect_ = rect;
+        }
+        return rect;
+    }
+    
+    /**
+     * Write the segment's metadata sidecar (crop rectangles, in source
+     * pixels, from the frame where each took effect).
+     */
+    void writeMetadataSidecar(const std::string& video_path) {
+        if (segment_crops_.empty()) {
+            return;
+        }
+        json metadata;
+        metadata["source_width"] = session_width_;
+        metadata["source_height"] = session_height_;
+        metadata["output_width"] = segment_width_;
+        metadata["output_height"] = segment_height_;
+        metadata["crops"] = segment_crops_;
+        std::ofstream out(segment_metadata_path(video_path));
+        if (!out) {
+            LOG(WARNING) << "Could not write segment metadata for " << video_path;
+            return;
+        }
+        out << metadata.dump() << '\n';
+    }
+    
+    /**
+     * Write the segment's frame time sidecar next to its video file.
+     */
+    void writeTimestampsSidecar(const std::string& video_path) {
+        if (segment_frame_times_us_.empty()) {
+            return;
+        }
+        std::ofstream out(segment_timestamps_path(video_path));
+        if (!out) {
+            LOG(WARNING) << "Could not write frame timestamps for " << video_path;
+            return;
+        }
+        int64_t first_us = segment_frame_times_us_.front();
+        for (int64_t time_us : segment_frame_times_us_) {
+            out << (time_us - first_us) << '\n';
+        }
+    }
+    
+    void startNewSegment() {
+        // Generate segment filename
+        auto now = std::chrono::system_clock::now();
+        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+        
+        // Frame counts are after decimation, so a segment keeps its duration
+        segment_quality_ = quality_;
+        decimation_counter_ = 0;
+        size_t divisor = static_cast<size_t>(std::max(1, segment_quality_.fps_divisor));
+        if (current_segment_index_ < session_ramp_frames_.size()) {
+            frames_per_segment_ = std::max(session_ramp_frames_[current_segment_index_] / divisor,
+                                           min_segment_frames_);
+        } else {
+            frames_per_segment_ = static_cast<size_t>(
+                steady_frames_per_segment_ * segment_quality_.segment_scale) / divisor;
+        }
+        frames_per_segment_ = std::max<size_t>(frames_per_segment_, 1);
+        segment_codec_ = benchmark_codecs_.empty()
+            ? session_codec_
+            : benchmark_codecs_[current_segment_index_ % benchmark_codecs_.size()];
+        current_video_path_ = recordings_dir_ + "/" + current_session_id_ + 
+                              "_seg" + std::to_string(current_segment_index_) + 
+                              "_" + std::to_string(timestamp) + recording_codec_extension(segment_codec_);
+        
+        // Initialize writer if we have dimensions
+        if (session_width_ > 0 && session_height_ > 0) {
+            initializeWriter(session_width_, session_height_);
+        }
+        
+        segment_frame_count_ = 0;
+        segment_timestamps_ = PipelineTimestamps{};
+        encode_stats_ = SegmentEncodeStats{};
+        segment_frame_times_us_.clear();
+        segment_crops_ = json::array();
+        
+        LOG(INFO) << "Started segment " << current_segment_index_ 
+                  << " for session " << current_session_id_;
+    }
+    
+    void finalizeCurrentSegment() {
+        // This version is called from addFrame, doesn't hold lock
+        finalizeCurrentSegmentLocked();
+        current_segment_index_++;
+    }
+    
+    std::string finalizeCurrentSegmentLocked() {
+        TraceSpan span("finalize", static_cast<int64_t>(current_segment_index_));
+        if (writerOpen()) {
+            writer_->release();
+        }
+        
+        std::string completed_path = current_video_path_;
+        std::string session_id = current_session_id_;
+        size_t segment_idx = current_segment_index_;
+        size_t frames = segment_frame_count_;
+        segment_timestamps_.segment_finalized = PipelineTimestamps::Clock::now();
+        g_stats.segments_finalized++;
+        
+        encode_stats_.codec = segment_codec_;
+        encode_stats_.frames = frames;
+        encode_stats_.quality_level = static_cast<int>(segment_quality_.level);
+        struct stat file_stat;
+        if (stat(completed_path.c_str(), &file_stat) == 0) {
+            encode_stats_.bytes = static_cast<uint64_t>(file_stat.st_size);
+        }
+        writeTimestampsSidecar(completed_path);
+        writeMetadataSidecar(completed_path);
+        
+        LOG(INFO) << "Completed segment " << segment_idx 
+                  << " with " << frames << " frames"
+                  << " -> " << completed_path;
+        
+        // Trigger callback for segment processing
+        // The callback just queues to SDK processor (very fast), so call directly
+        if (segment_ready_callback_ && frames > 0) {
+            segment_ready_callback_(completed_path, session_id, segment_idx, segment_timestamps_, encode_stats_);
+        }
+        
+        return completed_path;
+    }
+    
+    bool initializeWriter(int width, int height) {
+        session_width_ = width;
+        session_height_ = height;
+        cv::Size base = crop_size_.empty() ? cv::Size(session_width_, session_height_) : crop_size_;
+        segment_width_ = base.width;
+        segment_height_ = base.height;
+        if (segment_quality_.resolution_scale < 1.0) {
+            // Even dimensions keep 4:2:0 codecs happy
+            segment_width_ = std::max(2, static_cast<int>(base.width * segment_quality_.resolution_scale) & ~1);
+            segment_height_ = std::max(2, static_cast<int>(base.height * segment_quality_.resolution_scale) & ~1);
+        }
+        int fps = std::max(1, session_fps_ / std::max(1, segment_quality_.fps_divisor));
+        
+        cv::Size size(segment_width_, segment_height_);
+        writer_ = make_segment_writer(segment_codec_);
+        if (!writer_->open(current_video_path_, fps, size) &&
+            segment_codec_ != RecordingCodec::kMJPG) {
+            // The OpenCV build may lack an encoder (e.g. no FFmpeg backend);
+            // a recording in the default codec beats no recording
+            LOG(WARNING) << "Failed to open " << recording_codec_name(segment_codec_)
+                         << " writer, falling back to mjpg";
+            std::string extension = recording_codec_extension(segment_codec_);
+            current_video_path_ = current_video_path_.substr(0, current_video_path_.size() - extension.size()) +
+                                  recording_codec_extension(RecordingCodec::kMJPG);
+            segment_codec_ = RecordingCodec::kMJPG;
+            writer_ = make_segment_writer(segment_codec_);
+            writer_->open(current_video_path_, fps, size);
+        }
+        
+        if (!writer_->isOpened()) {
+            LOG(ERROR) << "Failed to open VideoWriter for " << current_video_path_;
+            return false;
+        }
+        
+        LOG(INFO) << "Initialized VideoWriter: " << segment_width_ << "x" << segment_height_ 
+                  << " @ " << fps << " fps (" << recording_codec_name(segment_codec_) << ")";
+        
+        return true;
+    }
+    
+    bool createDirectory(const std::string& path) {
+        // Simple directory creation using system call
+        std::string cmd = "mkdir -p \"" + path + "\"";
+        int result = system(cmd.c_str());
+        if (result != 0) {
+            LOG(WARNING) << "Could not create directory: " << path;
+            return false;
+        }
+        LOG(INFO) << "Ensured recordings directory exists: " << path;
+        return true;
+    }
+    
+    std::string recordings_dir_;
+    int default_fps_;
+    int segment_duration_seconds_;
+    
+    mutable std::mutex mutex_;
+    bool recording_;
+    std::string current_session_id_;
+    std::string current_video_path_;
+    int session_fps_;
+    int session_width_;
+    int session_height_;
+    int segment_width_ = 0;   // Session size scaled by the segment's quality settings
+    int segment_height_ = 0;
+    size_t total_frame_count_;
+    size_t segment_frame_count_;
+    size_t frames_per_segment_;  // Length of the segment being recorded
+    size_t steady_frames_per_segment_ = 0;
+    std::vector<size_t> session_ramp_frames_;
+    std::vector<double> default_ramp_seconds_;
+    size_t min_segment_frames_ = 0;
+    size_t current_segment_index_;
+    PipelineTimestamps segment_timestamps_;
+    SegmentEncodeStats encode_stats_;
+    
+    bool write_frame_timestamps_ = false;
+    bool client_clock_ = false;  // Session runs on client capture times
+    int64_t last_frame_time_us_ = 0;
+    int64_t last_arrival_us_ = 0;
+    std::vector<int64_t> segment_frame_times_us_;
+    
+    RecordingCodec default_codec_ = RecordingCodec::kMJPG;
+    RecordingCodec session_codec_ = RecordingCodec::kMJPG;
+    RecordingCodec segment_codec_ = RecordingCodec::kMJPG;
+    std::vector<RecordingCodec> benchmark_codecs_;
+    
+    QualitySettings quality_;          // Applies from the next segment
+    QualitySettings segment_quality_;  // Applies to the segment being recorded
+    size_t decimation_counter_ = 0;
+    
+    std::unique_ptr<FaceDetector> face_detector_;
+    size_t face_detect_interval_ = 1;
+    
+    static constexpr double kCropSmoothing = 0.3;  // Weight of each new detection in the target
+    static constexpr double kCropDeadband = 0.05;  // Target ignores moves under this fraction of the face width
+    static constexpr double kCropFollow = 0.15;    // Per-frame step of the box toward the target
+    cv::Size crop_size_;  // Empty = no face crop
+    double crop_padding_ = 0.5;
+    bool crop_tracking_ = false;  // A face has been seen this session
+    double crop_cx_ = 0.0;
+    double crop_cy_ = 0.0;
+    double crop_face_width_ = 0.0;
+    double crop_target_cx_ = 0.0;  // Smoothed detections the box glides toward
+    double crop_target_cy_ = 0.0;
+    double crop_target_width_ = 0.0;
+    cv::Rect crop_rect_;
+    json segment_crops_ = json::array();
+    
+    struct FeedbackWindow {
+        size_t frames = 0;
+        size_t dropped = 0;
+        size_t issue_counts[4] = {0, 0, 0, 0};  // Indexed by FrameQuality::Issue bit
+        double sharpness_sum = 0.0;
+        double brightness_sum = 0.0;
+        double motion_sum = 0.0;
+    };
+    static constexpr size_t kFeedbackRepeatWindows = 5;
+    std::unique_ptr<FrameQualityScreen> quality_screen_;
+    QualityFeedbackCallback quality_feedback_callback_;
+    FeedbackWindow feedback_window_;
+    std::vector<json> pending_feedback_;  // Sent by addFrame after mutex_ is released
+    uint32_t last_feedback_issues_ = 0;
+    size_t windows_since_feedback_ = 0;
+    
+    std::unique_ptr<SegmentWriter> writer_;
+    cv::Mat resize_buffer_;
+    SegmentReadyCallback segment_ready_callback_;
+};
+
+// Global session recorder (initialized in main)
+std::unique_ptr<SessionRecorder> g_session_recorder;
+
+// Forward declarations
+class MetricsServer;
+class SDKVideoProcessor;
+
+// Global pointers (initialized in main)
+MetricsServer* g_metrics_server = nullptr;
+std::unique_ptr<SDKVideoProcessor> g_sdk_processor;
+
+// TCP Server for metrics output
+class MetricsServer {
+public:
+    /**
+     * @param port TCP port to listen on
+     * @param unix_path Optional AF_UNIX socket path served by the same accept loop
+     * @param unix_type SOCK_STREAM or SOCK_SEQPACKET for the unix listener
+     */
+    MetricsServer(int port, const std::string& unix_path = "", int unix_type = SOCK_STREAM)
+        : port_(port), server_fd_(-1), unix_path_(unix_path), unix_type_(unix_type), unix_fd_(-1),
+          running_(false) {}
+    
+    ~MetricsServer() {
+        stop();
+    }
+    
+    bool start() {
+        server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (server_fd_ < 0) {
+            LOG(ERROR) << "Failed to create metrics socket";
+            return false;
+        }
+        
+        int opt = 1;
+        setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port_);
+        
+        if (bind(server_fd_, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            LOG(ERROR) << "Failed to bind metrics server to port " << port_;
+            close(server_fd_);
+            return false;
+        }
+        
+        if (listen(server_fd_, 5) < 0) {
+            LOG(ERROR) << "Failed to listen on metrics socket";
+            close(server_fd_);
+            return false;
+        }
+        
+        if (!unix_path_.empty()) {
+            unix_fd_ = create_unix_listener(unix_path_, unix_type_, 5);
+            if (unix_fd_ < 0) {
+                close(server_fd_);
+                return false;
+            }
+            LOG(INFO) << "Metrics server listening on unix socket " << unix_path_
+                      << " (" << socket_type_name(unix_type_) << ")";
+        }
+        
+        running_ = true;
+        server_thread_ = std::thread(&MetricsServer::acceptLoop, this);
+        
+        LOG(INFO) << "Metrics server listening on port " << port_;
+        return true;
+    }
+    
+    void stop() {
+        running_ = false;
+        if (server_fd_ >= 0) {
+            shutdown(server_fd_, SHUT_RDWR);
+            close(server_fd_);
+            server_fd_ = -1;
+        }
+        if (unix_fd_ >= 0) {
+            close(unix_fd_);
+            unix_fd_ = -1;
+            unlink(unix_path_.c_str());
+        }
+        if (server_thread_.joinable()) {
+            server_thread_.join();
+        }
+        
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (int fd : client_fds_) {
+            close(fd);
+        }
+        client_fds_.clear();
+    }
+    
+    void broadcast(const std::string& message) {
+        TraceSpan span("broadcast", static_cast<int64_t>(message.size()));
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        std::vector<int> disconnected;
+        
+        std::string msg_with_newline = message + "\n";
+        
+        for (int fd : client_fds_) {
+            ssize_t sent = send(fd, msg_with_newline.c_str(), msg_with_newline.size(), MSG_NOSIGNAL);
+            if (sent < 0) {
+                disconnected.push_back(fd);
+            }
+        }
+        g_stats.metrics_broadcasts++;
+        
+        for (int fd : disconnected) {
+            close(fd);
+            client_fds_.erase(fd);
+            LOG(INFO) << "Metrics client disconnected";
+        }
+    }
+    
+    bool hasClients() {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        return !client_fds_.empty();
+    }
+    
+    bool isRunning() const {
+        return running_.load();
+    }
+    
+    /**
+     * Bytes still queued in the kernel send buffer for each connected client.
+     * A growing value means that client is not keeping up with the broadcast rate.
+     */
+    std::vector<std::pair<int, int>> clientSendQueueDepths() {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        std::vector<std::pair<int, int>> depths;
+        for (int fd : client_fds_) {
+            int pending = 0;
+            if (ioctl(fd, SIOCOUTQ, &pending) < 0) {
+                pending = -1;
+            }
+            depths.emplace_back(fd, pending);
+        }
+        return depths;
+    }
+    
+private:
+    void acceptLoop() {
+        PipelineTracer::instance().setThreadName("metrics_accept");
+        
+        while (running_ && g_running) {
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(server_fd_, &readfds);
+            if (unix_fd_ >= 0) {
+                FD_SET(unix_fd_, &readfds);
+            }
+            
+            struct timeval tv;
+            tv.tv_sec = 1;
+            tv.tv_usec = 0;
+            
+            int activity = select(std::max(server_fd_, unix_fd_) + 1, &readfds, NULL, NULL, &tv);
+            
+            if (activity < 0 && errno != EINTR) {
+                continue;
+            }
+            
+            if (activity > 0 && FD_ISSET(server_fd_, &readfds)) {
+                struct sockaddr_in client_addr;
+                socklen_t client_len = sizeof(client_addr);
+                int client_fd = accept(server_fd_, (struct sockaddr*)&client_addr, &client_len);
+                
+                if (client_fd >= 0) {
+                    TraceSpan span("accept_metrics_client");
+                    std::lock_guard<std::mutex> lock(clients_mutex_);
+                    client_fds_.insert(client_fd);
+                    LOG(INFO) << "Metrics client connected from " << inet_ntoa(client_addr.sin_addr);
+                }
+            }
+            
+            if (activity > 0 && unix_fd_ >= 0 && FD_ISSET(unix_fd_, &readfds)) {
+                int client_fd = accept(unix_fd_, NULL, NULL);
+                
+                if (client_fd >= 0) {
+                    TraceSpan span("accept_metrics_client");
+                    std::lock_guard<std::mutex> lock(clients_mutex_);
+                    client_fds_.insert(client_fd);
+                    LOG(INFO) << "Metrics client connected on " << unix_path_;
+                }
+            }
+        }
+    }
+    
+    int port_;
+    int server_fd_;
+    std::string unix_path_;
+    int unix_type_;
+    int unix_fd_;
+    std::atomic<bool> running_;
+    std::thread server_thread_;
+    std::mutex clients_mutex_;
+    std::set<int> client_fds_;
+};
+
+// ============================================================================
+// Codec Benchmark - Per-codec cost and confidence totals
+// ============================================================================
+
+/**
+ * Aggregates segment encode cost and SDK confidence per recording codec while
+ * PRESAGE_CODEC_BENCHMARK rotates codecs. Each update is logged and broadcast
+ * as a "codec_benchmark" message on the metrics channel.
+ */
+class CodecBenchmark {
+public:
+    void record(const SegmentEncodeStats& stats, size_t metrics_count,
+                double mean_pulse_confidence, double mean_breathing_confidence) {
+        json report;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Totals& totals = totals_[recording_codec_name(stats.codec)];
+            totals.segments++;
+            totals.frames += stats.frames;
+            totals.encode_cpu_ms += stats.encode_cpu_ms;
+            totals.bytes += stats.bytes;
+            totals.metrics += metrics_count;
+            totals.pulse_confidence_sum += mean_pulse_confidence;
+            totals.breathing_confidence_sum += mean_breathing_confidence;
+            
+            report["type"] = "codec_benchmark";
+            for (const auto& [codec, t] : totals_) {
+                json entry;
+                entry["segments"] = t.segments;
+                entry["frames"] = t.frames;
+                entry["encode_cpu_ms_per_frame"] = t.frames > 0 ? t.encode_cpu_ms / t.frames : 0.0;
+                entry["bytes_per_frame"] = t.frames > 0 ? static_cast<double>(t.bytes) / t.frames : 0.0;
+                entry["metrics"] = t.metrics;
+                entry["mean_pulse_confidence"] = t.pulse_confidence_sum / t.segments;
+                entry["mean_breathing_confidence"] = t.breathing_confidence_sum / t.segments;
+                report["codecs"][codec] = entry;
+                
+                LOG(INFO) << "Codec benchmark " << codec << ": " << t.segments << " segments, "
+                          << entry["encode_cpu_ms_per_frame"].get<double>() << " ms/frame encode, "
+                          << static_cast<uint64_t>(entry["bytes_per_frame"].get<double>()) << " bytes/frame, "
+                          << "pulse confidence " << entry["mean_pulse_confidence"].get<double>();
+            }
+        }
+        if (g_metrics_server) {
+            g_metrics_server->broadcast(report.dump());
+        }
+    }
+    
+private:
+    struct Totals {
+        size_t segments = 0;
+        size_t frames = 0;
+        double encode_cpu_ms = 0.0;
+        uint64_t bytes = 0;
+        size_t metrics = 0;
+        double pulse_confidence_sum = 0.0;
+        double breathing_confidence_sum = 0.0;
+    };
+    
+    std::mutex mutex_;
+    std::map<std::string, Totals> totals_;
+};
+
+// Set in main when PRESAGE_CODEC_BENCHMARK is configured
+std::unique_ptr<CodecBenchmark> g_codec_benchmark;
+
+// ============================================================================
+// Segment Journal - Crash-safe record of queued SDK jobs
+// ============================================================================
+
+/**
+ * Append-only JSON-lines journal of segment jobs so queued work survives a
+ * restart.
+ * 
+ * Records: {"op":"enqueue","job":N,"session_id":..,"segment_index":..,"video_path":..},
+ * {"op":"start","job":N} and {"op":"complete","job":N}. Appends go straight to
+ * the file; a flusher thread fsyncs them in batches at most `fsync_ms` apart.
+ * On open, the journal is replayed and compacted down to the incomplete jobs.
+ */
+class SegmentJournal {
+public:
+    struct PendingJob {
+        uint64_t job_id = 0;
+        std::string session_id;
+        size_t segment_index = 0;
+        std::string video_path;
+        int start_count = 0;  // Times the SDK picked it up before the restart
+    };
+    
+    // A job that was started this many times without completing is assumed to
+    // take the daemon down and is dropped instead of resumed
+    static constexpr int kMaxStarts = 2;
+    
+    SegmentJournal(const std::string& path, int fsync_ms)
+        : path_(path), fsync_ms_(fsync_ms) {}
+    
+    ~SegmentJournal() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        flush_cv_.notify_all();
+        if (flush_thread_.joinable()) {
+            flush_thread_.join();
+        }
+        if (fd_ >= 0) {
+            fsync(fd_);
+            close(fd_);
+        }
+    }
+    
+    /**
+     * Replay the existing journal, compact it and start appending.
+     * 
+     * @param pending Receives jobs that were enqueued but never completed
+     * @return false if the journal file can't be written
+     */
+    bool open(std::vector<PendingJob>* pending) {
+        std::map<uint64_t, PendingJob> jobs;
+        std::ifstream in(path_);
+        std::string line;
+        size_t corrupt = 0;
+        while (std::getline(in, line)) {
+            try {
+                json record = json::parse(line);
+                uint64_t job_id = record.at("job").get<uint64_t>();
+                std::string op = record.at("op").get<std::string>();
+                next_job_id_ = std::max(next_job_id_, job_id + 1);
+                if (op == "enqueue") {
+                    PendingJob& job = jobs[job_id];
+                    job.job_id = job_id;
+                    job.session_id = record.value("session_id", "");
+                    job.segment_index = record.value("segment_index", static_cast<size_t>(0));
+                    job.video_path = record.value("video_path", "");
+                    job.start_count = record.value("starts", 0);
+                } else if (op == "start" && jobs.count(job_id)) {
+                    jobs[job_id].start_count++;
+                } else if (op == "complete") {
+                    jobs.erase(job_id);
+                }
+            } catch (const std::exception&) {
+                corrupt++;  // A torn final line from a crash mid-append
+            }
+        }
+        in.close();
+        if (corrupt > 0) {
+            LOG(WARNING) << "Skipped " << corrupt << " unreadable journal records in " << path_;
+        }
+        
+        // Rewrite the journal with only the surviving jobs
+        std::string tmp_path = path_ + ".tmp";
+        int tmp_fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (tmp_fd < 0) {
+            LOG(ERROR) << "Failed to create segment journal " << tmp_path;
+            return false;
+        }
+        for (auto& [job_id, job] : jobs) {
+            if (job.start_count >= kMaxStarts) {
+                LOG(WARNING) << "Dropping journaled segment " << job.segment_index << " of session "
+                             << job.session_id << " after " << job.start_count << " failed attempts";
+                continue;
+            }
+            std::string record = enqueueRecord(job.job_id, job.session_id, job.segment_index,
+                                               job.video_path, job.start_count);
+            if (::write(tmp_fd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+                LOG(ERROR) << "Failed to compact segment journal";
+                close(tmp_fd);
+                return false;
+            }
+            pending->push_back(job);
+        }
+        fsync(tmp_fd);
+        close(tmp_fd);
+        if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            LOG(ERROR) << "Failed to replace segment journal " << path_;
+            return false;
+        }
+        
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd_ < 0) {
+            LOG(ERROR) << "Failed to open segment journal " << path_;
+            return false;
+        }
+        flush_thread_ = std::thread(&SegmentJournal::flushLoop, this);
+        
+        LOG(INFO) << "Segment journal " << path_ << ": " << pending->size() << " incomplete jobs to resume";
+        return true;
+    }
+    
+    uint64_t recordEnqueue(const std::string& session_id, size_t segment_index,
+                           const std::string& video_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t job_id = next_job_id_++;
+        appendLocked(enqueueRecord(job_id, session_id, segment_index, video_path, 0));
+        return job_id;
+    }
+    
+    void recordStart(uint64_t job_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendLocked(opRecord("start", job_id));
+    }
+    
+    void recordComplete(uint64_t job_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendLocked(opRecord("complete", job_id));
+    }
+    
+private:
+    static std::string enqueueRecord(uint64_t job_id, const std::string& session_id,
+                                     size_t segment_index, const std::string& video_path, int starts) {
+        json record;
+        record["op"] = "enqueue";
+        record["job"] = job_id;
+        record["session_id"] = session_id;
+        record["segment_index"] = segment_index;
+        record["video_path"] = video_path;
+        if (starts > 0) {
+            record["starts"] = starts;
+        }
+        return record.dump() + "\n";
+    }
+    
+    static std::string opRecord(const char* op, uint64_t job_id) {
+        json record;
+        record["op"] = op;
+        record["job"] = job_id;
+        return record.dump() + "\n";
+    }
+    
+    void appendLocked(const std::string& record) {
+        if (fd_ < 0) {
+            return;
+        }
+        // One write per record with O_APPEND: a crash can only tear the last line
+        if (::write(fd_, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+            LOG(WARNING) << "Failed to append to segment journal";
+            return;
+        }
+        dirty_ = true;
+        flush_cv_.notify_one();
+    }
+    
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            flush_cv_.wait(lock, [this]() { return stopping_ || dirty_; });
+            if (stopping_) {
+                break;
+            }
+            // Let a burst of records accumulate, then make them durable together
+            flush_cv_.wait_for(lock, std::chrono::milliseconds(fsync_ms_), [this]() { return stopping_; });
+            dirty_ = false;
+            int fd = fd_;
+            lock.unlock();
+            fdatasync(fd);
+            lock.lock();
+        }
+    }
+    
+    std::string path_;
+    int fsync_ms_;
+    int fd_ = -1;
+    uint64_t next_job_id_ = 1;
+    
+    std::mutex mutex_;
+    std::condition_variable flush_cv_;
+    std::thread flush_thread_;
+    bool dirty_ = false;
+    bool stopping_ = false;
+};
+
+// Set in main unless PRESAGE_JOURNAL_PATH is empty
+std::unique_ptr<SegmentJournal> g_segment_journal;
+
+// ============================================================================
+// Recording Janitor - Retention and disk quota for recorded segments
+// ============================================================================
+
+/**
+ * Background cleanup of the recordings directory.
+ * 
+ * Policies (any combination): delete a segment once the SDK has processed it,
+ * delete segments older than `retention_hours`, and keep the directory under
+ * `max_bytes` by evicting the least recently written segments. A segment's
+ * frame time sidecar goes with it. Segments still being recorded, queued or
+ * processed are never touched. The janitor thread runs at idle I/O priority
+ * so deletes don't compete with segment writes.
+ */
+class RecordingJanitor {
+public:
+    struct Policy {
+        bool delete_processed = false;
+        int retention_hours = 0;
+        uint64_t max_bytes = 0;
+        int interval_seconds = 60;
+    };
+    
+    RecordingJanitor(const std::string& recordings_dir, const Policy& policy)
+        : recordings_dir_(recordings_dir), policy_(policy) {
+        thread_ = std::thread(&RecordingJanitor::run, this);
+    }
+    
+    ~RecordingJanitor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+    
+    /**
+     * Protect a segment from deletion while it is queued or processing.
+     */
+    void acquire(const std::string& video_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use_[video_path]++;
+    }
+    
+    void release(const std::string& video_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = in_use_.find(video_path);
+        if (it != in_use_.end() && --it->second == 0) {
+            in_use_.erase(it);
+        }
+    }
+    
+    /**
+     * Called after the SDK processed a segment successfully.
+     */
+    void segmentProcessed(const std::string& video_path) {
+        if (!policy_.delete_processed) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            processed_.push_back(video_path);
+        }
+        cv_.notify_one();
+    }
+    
+private:
+    struct Recording {
+        std::string path;
+        uint64_t bytes = 0;  // Video plus sidecar
+        time_t mtime = 0;
+    };
+    
+    void run() {
+        PipelineTracer::instance().setThreadName("janitor");
+        // Idle I/O class: only touch the disk when nothing else wants it
+        constexpr int kIoprioWhoProcess = 1;
+        constexpr int kIoprioClassIdle = 3;
+        constexpr int kIoprioClassShift = 13;
+        if (syscall(SYS_ioprio_set, kIoprioWhoProcess, static_cast<int>(syscall(SYS_gettid)),
+                    kIoprioClassIdle << kIoprioClassShift) != 0) {
+            LOG(WARNING) << "Janitor could not lower its I/O priority";
+        }
+        
+        auto next_sweep = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            cv_.wait_until(lock, next_sweep, [this]() { return stopping_ || !processed_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            
+            std::vector<std::string> processed;
+            processed.swap(processed_);
+            lock.unlock();
+            for (const auto& path : processed) {
+                if (!isInUse(path)) {
+                    removeRecording(path, "processed");
+                }
+            }
+            if (std::chrono::steady_clock::now() >= next_sweep) {
+                sweep();
+                next_sweep = std::chrono::steady_clock::now() + std::chrono::seconds(policy_.interval_seconds);
+            }
+            lock.lock();
+        }
+    }
+    
+    bool isInUse(const std::string& path) {
+        if (g_session_recorder && g_session_recorder->getCurrentVideoPath() == path) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        return in_use_.count(path) > 0;
+    }
+    
+    static bool isRecordingFile(const std::string& name) {
+        static const char* kExtensions[] = {".avi", ".mkv", ".y4m", ".mp4"};
+        for (const char* extension : kExtensions) {
+            size_t length = std::strlen(extension);
+            if (name.size() > length && name.compare(name.size() - length, length, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    std::vector<Recording> listRecordings() {
+        std::vector<Recording> recordings;
+        DIR* dir = opendir(recordings_dir_.c_str());
+        if (!dir) {
+            return recordings;
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (!isRecordingFile(name)) {
+                continue;
+            }
+            Recording recording;
+            recording.path = recordings_dir_ + "/" + name;
+            struct stat file_stat;
+            if (stat(recording.path.c_str(), &file_stat) != 0) {
+                continue;
+            }
+            recording.bytes = file_stat.st_size;
+            recording.mtime = file_stat.st_mtime;
+            for (const auto& sidecar : segment_sidecar_paths(recording.path)) {
+                if (stat(sidecar.c_str(), &file_stat) == 0) {
+                    recording.bytes += file_stat.st_size;
+                }
+            }
+            recordings.push_back(recording);
+        }
+        closedir(dir);
+        return recordings;
+    }
+    
+    void sweep() {
+        std::vector<Recording> recordings = listRecordings();
+        std::sort(recordings.begin(), recordings.end(),
+                  [](const Recording& a, const Recording& b) { return a.mtime < b.mtime; });
+        
+        uint64_t total_bytes = 0;
+        for (const auto& recording : recordings) {
+            total_bytes += recording.bytes;
+        }
+        
+        time_t cutoff = policy_.retention_hours > 0 ? time(nullptr) - policy_.retention_hours * 3600 : 0;
+        for (const auto& recording : recordings) {
+            bool expired = recording.mtime < cutoff;
+            bool over_quota = policy_.max_bytes > 0 && total_bytes > policy_.max_bytes;
+            if (!expired && !over_quota) {
+                break;  // Sorted oldest first: nothing later is expired either
+            }
+            if (isInUse(recording.path)) {
+                continue;
+            }
+            if (removeRecording(recording.path, expired ? "expired" : "quota")) {
+                total_bytes -= recording.bytes;
+            }
+        }
+        
+        g_stats.recordings_bytes = total_bytes;
+        if (policy_.max_bytes > 0 && total_bytes > policy_.max_bytes) {
+            LOG(WARNING) << "Recordings use " << total_bytes << " bytes, over the " << policy_.max_bytes
+                         << " byte quota, but the remaining segments are in use";
+        }
+    }
+    
+    bool removeRecording(const std::string& path, const char* reason) {
+        struct stat file_stat;
+        uint64_t bytes = stat(path.c_str(), &file_stat) == 0 ? file_stat.st_size : 0;
+        if (unlink(path.c_str()) != 0) {
+            return false;
+        }
+        for (const auto& sidecar : segment_sidecar_paths(path)) {
+            if (stat(sidecar.c_str(), &file_stat) == 0 && unlink(sidecar.c_str()) == 0) {
+                bytes += file_stat.st_size;
+                g_stats.janitor_files_deleted++;
+            }
+        }
+        g_stats.janitor_files_deleted++;
+        g_stats.janitor_bytes_deleted += bytes;
+        VLOG(1) << "Janitor deleted " << path << " (" << reason << ", " << bytes << " bytes)";
+        return true;
+    }
+    
+    std::string recordings_dir_;
+    Policy policy_;
+    
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool stopping_ = false;
+    std::map<std::string, int> in_use_;
+    std::vector<std::string> processed_;
+};
+
+// Set in main when any retention policy is enabled
+std::unique_ptr<RecordingJanitor> g_recording_janitor;
+
+// ============================================================================
+// SDK Result Cache - Replays SDK output for video it has already seen
+// ============================================================================
+
+/**
+ * One-shot XXH64. Inlined rather than linked: the cache only needs a fast,
+ * well-mixed 64-bit content hash.
+ */
+uint64_t xxh64(const void* data, size_t length, uint64_t seed) {
+    constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+    constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+    constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+    constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+    constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+    auto read32 = [](const uint8_t* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+    auto round = [&rotl](uint64_t acc, uint64_t input) {
+        acc += input * kPrime2;
+        return rotl(acc, 31) * kPrime1;
+    };
+    auto merge = [&round](uint64_t acc, uint64_t value) {
+        acc ^= round(0, value);
+        return acc * kPrime1 + kPrime4;
+    };
+    
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + length;
+    uint64_t hash;
+    if (length >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge(hash, v1);
+        hash = merge(hash, v2);
+        hash = merge(hash, v3);
+        hash = merge(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += length;
+    for (; p + 8 <= end; p += 8) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= read32(p) * kPrime1;
+        hash = rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime5;
+        hash = rotl(hash, 11) * kPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * On-disk cache of SDK outputs, keyed by what the SDK actually reads: the
+ * video's bytes, its frame time sidecar and a fingerprint of the settings.
+ * A hit replays the stored metrics and status callbacks in order, with no
+ * container and no upload. So replays, retries and post-restart
+ * reprocessing of identical video cost a file read.
+ * 
+ * Each entry is one file named by its key. Least recently used entries are
+ * evicted beyond max_bytes. A hit touches the file's mtime, so the LRU
+ * order survives restarts.
+ */
+class SdkResultCache {
+public:
+    struct Record {
+        enum Kind : uint8_t {
+            kMetrics = 1,  // payload is a serialized MetricsBuffer
+            kStatus = 2,   // status_code is an imaging status change
+        };
+        Kind kind = kMetrics;
+        int64_t timestamp = 0;
+        int32_t status_code = 0;
+        std::string payload;
+    };
+    
+    SdkResultCache(const std::string& dir, uint64_t max_bytes) : dir_(dir), max_bytes_(max_bytes) {}
+    
+    /**
+     * Create the directory if needed and index the entries already in it.
+     */
+    bool open() {
+        if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOG(ERROR) << "Cannot create SDK cache directory " << dir_ << ": " << strerror(errno);
+            return false;
+        }
+        DIR* dir = opendir(dir_.c_str());
+        if (!dir) {
+            LOG(ERROR) << "Cannot open SDK cache directory " << dir_;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            size_t suffix_length = std::strlen(kSuffix);
+            if (name.size() != 16 + suffix_length || name.compare(16, suffix_length, kSuffix) != 0) {
+                continue;
+            }
+            std::string key_hex = name.substr(0, 16);
+            char* key_end = nullptr;
+            uint64_t key = std::strtoull(key_hex.c_str(), &key_end, 16);
+            if (*key_end != '\0') {
+                continue;
+            }
+            struct stat file_stat;
+            if (stat((dir_ + "/" + name).c_str(), &file_stat) != 0) {
+                continue;
+            }
+            Entry cached;
+            cached.bytes = file_stat.st_size;
+            cached.last_used_ns = file_stat.st_mtim.tv_sec * 1000000000LL + file_stat.st_mtim.tv_nsec;
+            entries_[key] = cached;
+            total_bytes_ += cached.bytes;
+        }
+        closedir(dir);
+        evictLocked();
+        LOG(INFO) << "SDK result cache: " << entries_.size() << " entries, " << total_bytes_ << " bytes";
+        return true;
+    }
+    
+    /**
+     * Content key of a video file and its frame time sidecar under the given
+     * settings fingerprint. The file is hashed in chunks, each chunk's hash
+     * seeding the next.
+     * 
+     * @return The key, or 0 if the video can't be read
+     */
+    uint64_t keyFor(const std::string& video_path, const std::string& fingerprint) const {
+        uint64_t hash = xxh64(fingerprint.data(), fingerprint.size(), 0);
+        std::vector<char> chunk(kHashChunkBytes);
+        auto hash_file = [&](const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                return false;
+            }
+            while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+                hash = xxh64(chunk.data(), static_cast<size_t>(in.gcount()), hash);
+            }
+            return true;
+        };
+        if (!hash_file(video_path)) {
+            return 0;
+        }
+        hash_file(segment_timestamps_path(video_path));  // Optional
+        return hash == 0 ? 1 : hash;
+    }
+    
+    /**
+     * @return true on a hit, with the run's callbacks in `records`
+     */
+    bool load(uint64_t key, std::vector<Record>* records) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end()) {
+                g_stats.sdk_cache_misses++;
+                return false;
+            }
+            it->second.last_used_ns = nowNs();
+        }
+        std::string path = entryPath(key);
+        if (!readEntry(path, records)) {
+            LOG(WARNING) << "Dropping unreadable SDK cache entry " << path;
+            remove(key);
+            g_stats.sdk_cache_misses++;
+            return false;
+        }
+        utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+        g_stats.sdk_cache_hits++;
+        return true;
+    }
+    
+    /**
+     * Save a completed run's callbacks, then evict down to the size limit.
+     */
+    void store(uint64_t key, const std::vector<Record>& records) {
+        std::string path = entryPath(key);
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            out.write(kMagic, sizeof(kMagic));
+            writeValue(out, static_cast<uint32_t>(records.size()));
+            for (const auto& record : records) {
+                writeValue(out, static_cast<uint8_t>(record.kind));
+                writeValue(out, record.timestamp);
+                writeValue(out, record.status_code);
+                writeValue(out, static_cast<uint32_t>(record.payload.size()));
+                out.write(record.payload.data(), record.payload.size());
+            }
+            if (!out) {
+                LOG(WARNING) << "Failed to write SDK cache entry " << tmp_path;
+                unlink(tmp_path.c_str());
+                return;
+            }
+        }
+        struct stat file_stat;
+        if (rename(tmp_path.c_str(), path.c_str()) != 0 || stat(path.c_str(), &file_stat) != 0) {
+            unlink(tmp_path.c_str());
+            return;
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            total_bytes_ -= it->second.bytes;
+        }
+        Entry& cached = entries_[key];
+        cached.bytes = file_stat.st_size;
+        cached.last_used_ns = nowNs();
+        total_bytes_ += cached.bytes;
+        evictLocked();
+    }
+    
+    static Record metricsRecord(const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+        Record record;
+        record.kind = Record::kMetrics;
+        record.timestamp = timestamp;
+        metrics.SerializeToString(&record.payload);
+        return record;
+    }
+    
+    static Record statusRecord(int status_code, int64_t timestamp) {
+        Record record;
+        record.kind = Record::kStatus;
+        record.timestamp = timestamp;
+        record.status_code = status_code;
+        return record;
+    }
+    
+    /**
+     * Feed stored records back through a run's callbacks, in their
+     * original order.
+     */
+    static void replay(const std::vector<Record>& records,
+                       const std::function<void(const presage::physiology::MetricsBuffer&, int64_t)>& on_metrics,
+                       const std::function<void(int, int64_t)>& on_status) {
+        for (const auto& record : records) {
+            if (record.kind == Record::kStatus) {
+                on_status(record.status_code, record.timestamp);
+                continue;
+            }
+            presage::physiology::MetricsBuffer metrics;
+            if (metrics.ParseFromString(record.payload)) {
+                on_metrics(metrics, record.timestamp);
+            }
+        }
+    }
+    
+private:
+    struct Entry {
+        uint64_t bytes = 0;
+        int64_t last_used_ns = 0;
+    };
+    
+    static constexpr char kMagic[8] = {'P', 'S', 'D', 'K', 'C', 'v', '1', '\n'};
+    static constexpr const char* kSuffix = ".sdkcache";
+    static constexpr size_t kHashChunkBytes = 1 << 20;
+    static constexpr uint32_t kMaxPayloadBytes = 64 << 20;
+    
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    std::string entryPath(uint64_t key) const {
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        return dir_ + "/" + name + kSuffix;
+    }
+    
+    template <typename T>
+    static void writeValue(std::ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    
+    template <typename T>
+    static bool readValue(std::ifstream& in, T* value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(value), sizeof(*value)));
+    }
+    
+    static bool readEntry(const std::string& path, std::vector<Record>* records) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(kMagic)];
+        uint32_t count = 0;
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            !readValue(in, &count)) {
+            return false;
+        }
+        records->clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            Record record;
+            uint8_t kind = 0;
+            uint32_t payload_size = 0;
+            if (!readValue(in, &kind) || !readValue(in, &record.timestamp) ||
+                !readValue(in, &record.status_code) || !readValue(in, &payload_size) ||
+                (kind != Record::kMetrics && kind != Record::kStatus) || payload_size > kMaxPayloadBytes) {
+                return false;
+            }
+            record.kind = static_cast<Record::Kind>(kind);
+            record.payload.resize(payload_size);
+            if (payload_size > 0 && !in.read(&record.payload[0], payload_size)) {
+                return false;
+            }
+            records->push_back(std::move(record));
+        }
+        return true;
+    }
+    
+    void remove(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            total_bytes_ -= it->second.bytes;
+            entries_.erase(it);
+        }
+        unlink(entryPath(key).c_str());
+        g_stats.sdk_cache_bytes = total_bytes_;
+    }
+    
+    void evictLocked() {
+        while (max_bytes_ > 0 && total_bytes_ > max_bytes_ && !entries_.empty()) {
+            auto oldest = std::min_element(entries_.begin(), entries_.end(),
+                [](const auto& a, const auto& b) { return a.second.last_used_ns < b.second.last_used_ns; });
+            unlink(entryPath(oldest->first).c_str());
+            total_bytes_ -= oldest->second.bytes;
+            entries_.erase(oldest);
+            g_stats.sdk_cache_evictions++;
+        }
+        g_stats.sdk_cache_bytes = total_bytes_;
+    }
+    
+    std::string dir_;
+    uint64_t max_bytes_;
+    
+    std::mutex mutex_;
+    std::map<uint64_t, Entry> entries_;
+    uint64_t total_bytes_ = 0;
+};
+
+// Set in main when PRESAGE_SDK_CACHE_DIR is configured
+std::unique_ptr<SdkResultCache> g_sdk_result_cache;
+
+// ============================================================================
+// Adaptive Quality Controller - Trades recording quality for SDK throughput
+// ============================================================================
+
+/**
+ * Keeps segment latency bounded when the SDK can't keep up. After each SDK
+ * job it looks at the backlog and the job's run time per second of video
+ * (smoothed); while the worker is behind it steps down one level at a time
+ * (longer segments, then half fps, then half resolution) and steps back up
+ * once the queue has stayed empty with spare capacity. Each change is
+ * broadcast as a quality_adjusted status and applies from the next segment.
+ * Only jobs recorded at the current level are judged, so a backlog of
+ * segments from before a change can't push it further before the new
+ * level has been measured.
+ */
+class AdaptiveQualityController {
+public:
+    explicit AdaptiveQualityController(size_t queue_high)
+        : queue_high_(std::max<size_t>(queue_high, 1)) {}
+    
+    /**
+     * Feed one finished SDK job. Called from the SDK worker.
+     * 
+     * @param run_seconds Wall time the SDK spent on the segment
+     * @param media_seconds Capture span of the segment (<= 0 if unknown)
+     * @param queue_depth Segments still waiting
+     * @param recorded_level Level the segment was recorded at (-1 = unknown)
+     */
+    void observeJob(double run_seconds, double media_seconds, size_t queue_depth, int recorded_level) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (recorded_level != static_cast<int>(level_)) {
+            return;  // Recorded before the last change: says nothing about this level
+        }
+        if (media_seconds > 0.0 && run_seconds >= 0.0) {
+            double load = run_seconds / media_seconds;
+            load_ = have_load_ ? kLoadAlpha * load + (1.0 - kLoadAlpha) * load_ : load;
+            have_load_ = true;
+        }
+        
+        bool behind = queue_depth >= queue_high_ || load_ > kOverloadedLoad;
+        bool spare = queue_depth == 0 && load_ < kRecoveredLoad;
+        calm_jobs_ = spare ? calm_jobs_ + 1 : 0;
+        
+        if (behind && level_ + 1 < kLevels.size()) {
+            setLevel(level_ + 1, queue_depth, "backlog");
+        } else if (level_ > 0 && calm_jobs_ >= kRecoverJobs) {
+            setLevel(level_ - 1, queue_depth, "capacity");
+        }
+    }
+    
+    size_t level() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return level_;
+    }
+    
+private:
+    static constexpr double kLoadAlpha = 0.3;
+    static constexpr double kOverloadedLoad = 1.0;  // Slower than real time
+    static constexpr double kRecoveredLoad = 0.6;
+    static constexpr size_t kRecoverJobs = 5;
+    
+    // Cheapest change first: longer segments amortize SDK startup without
+    // losing any frames
+    static const std::vector<QualitySettings> kLevels;
+    
+    void setLevel(size_t level, size_t queue_depth, const char* reason) {
+        bool reduced = level > level_;
+        level_ = level;
+        calm_jobs_ = 0;
+        have_load_ = false;  // Run time per second of video differs at the new level
+        g_stats.quality_level = level_;
+        
+        QualitySettings quality = kLevels[level_];
+        quality.level = level_;
+        if (g_session_recorder) {
+            g_session_recorder->setQualitySettings(quality);
+        }
+        
+        LOG(INFO) << "Quality " << (reduced ? "reduced" : "restored") << " to level " << level_
+                  << " (segment x" << quality.segment_scale << ", fps /" << quality.fps_divisor
+                  << ", resolution x" << quality.resolution_scale << "; queue " << queue_depth
+                  << ", load " << load_ << ")";
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = "quality_adjusted";
+            status_msg["level"] = level_;
+            status_msg["direction"] = reduced ? "reduced" : "restored";
+            status_msg["reason"] = reason;
+            status_msg["segment_scale"] = quality.segment_scale;
+            status_msg["fps_divisor"] = quality.fps_divisor;
+            status_msg["resolution_scale"] = quality.resolution_scale;
+            status_msg["queue_depth"] = queue_depth;
+            status_msg["load"] = load_;
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+    }
+    
+    size_t queue_high_;
+    
+    mutable std::mutex mutex_;
+    size_t level_ = 0;
+    double load_ = 0.0;  // EWMA of SDK seconds per second of video
+    bool have_load_ = false;
+    size_t calm_jobs_ = 0;
+};
+
+const std::vector<QualitySettings> AdaptiveQualityController::kLevels = {
+    {1.0, 1, 1.0},
+    {2.0, 1, 1.0},
+    {2.0, 2, 1.0},
+    {2.0, 2, 0.5},
+};
+
+// Set in main when PRESAGE_ADAPTIVE_QUALITY is on
+std::unique_ptr<AdaptiveQualityController> g_quality_controller;
+
+// ============================================================================
+// SDK Video Processor - Processes recorded video files with SmartSpectra SDK
+// ============================================================================
+
+using namespace presage::smartspectra;
+
+/**
+ * Tracks one SDK run's imaging status on the video's own clock and says
+ * when to give up: once the status has been anything but OK for longer
+ * than the limit, the rest of the input would only yield zero-confidence
+ * metrics.
+ */
+class ImagingStatusWatch {
+public:
+    explicit ImagingStatusWatch(double max_bad_seconds) : max_bad_us_(static_cast<int64_t>(max_bad_seconds * 1e6)) {}
+    
+    /**
+     * @param status_code SDK status code (0 = OK)
+     * @param timestamp_us Media time of the status change
+     * @return true if the run should stop now
+     */
+    bool update(int status_code, int64_t timestamp_us) {
+        if (first_us_ < 0) {
+            first_us_ = timestamp_us;
+        }
+        last_code_ = status_code;
+        if (status_code == 0) {
+            bad_since_us_ = -1;
+            return false;
+        }
+        if (bad_since_us_ < 0) {
+            bad_since_us_ = timestamp_us;
+        }
+        if (max_bad_us_ > 0 && timestamp_us - bad_since_us_ >= max_bad_us_) {
+            aborted_ = true;
+        }
+        return aborted_;
+    }
+    
+    /**
+     * Re-check the current status at a later media time. The SDK only
+     * reports status changes, so a face lost for good produces a single
+     * callback; calling this per frame lets that stretch still run out.
+     *
+     * @return true if the run should stop now
+     */
+    bool tick(int64_t timestamp_us) {
+        if (first_us_ < 0 || last_code_ == 0) {
+            return aborted_;
+        }
+        return update(last_code_, timestamp_us);
+    }
+    
+    bool aborted() const { return aborted_; }
+    int lastCode() const { return last_code_; }
+    
+    /**
+     * Seconds into the video where the unusable stretch began.
+     */
+    double badSinceSeconds() const {
+        return bad_since_us_ < 0 ? 0.0 : (bad_since_us_ - first_us_) / 1e6;
+    }
+    
+private:
+    int64_t max_bad_us_;
+    int64_t first_us_ = -1;
+    int64_t bad_since_us_ = -1;
+    int last_code_ = 0;
+    bool aborted_ = false;
+};
+
+using SegmentSdkSettings = container::settings::Settings<
+    container::settings::OperationMode::Continuous,
+    container::settings::IntegrationMode::Rest
+>;
+
+/**
+ * SDK settings for one recorded segment, shared by in-process runs and
+ * worker processes so both see the same configuration.
+ */
+SegmentSdkSettings make_segment_sdk_settings(const std::string& video_path, const std::string& api_key,
+                                             int frame_width, int frame_height) {
+    SegmentSdkSettings settings;
+    
+    // Configure video source for file input
+    settings.video_source.input_video_path = video_path;
+    settings.video_source.device_index = -1;  // Disable camera, use file
+    settings.video_source.capture_width_px = frame_width;
+    settings.video_source.capture_height_px = frame_height;
+    settings.video_source.codec = presage::camera::CaptureCodec::MJPG;
+    settings.video_source.auto_lock = true;
+    
+    // Real frame times, when the recorder wrote them, replace the nominal fps
+    std::string time_path = segment_timestamps_path(video_path);
+    struct stat time_stat;
+    if (stat(time_path.c_str(), &time_stat) == 0) {
+        settings.video_source.input_video_time_path = time_path;
+    }
+    
+    // SDK configuration
+    settings.headless = true;  // No GUI
+    settings.enable_edge_metrics = true;
+    settings.verbosity_level = 0;  // Reduce logging for segments
+    settings.continuous.preprocessed_data_buffer_duration_s = 0.25;  // Reduced for faster initial metrics
+    settings.integration.api_key = api_key;
+    return settings;
+}
+
+// ============================================================================
+// SDK Worker Processes - Crash-isolated SmartSpectra runs
+// ============================================================================
+
+/**
+ * Serialize a MetricsBuffer into a new memfd, to be handed to the daemon
+ * with SCM_RIGHTS. The daemon maps the same pages, so trace-heavy buffers
+ * never pass through the socket.
+ * 
+ * @return The memfd, or -1 on failure
+ */
+int write_metrics_memfd(const presage::physiology::MetricsBuffer& metrics) {
+    int fd = memfd_create("presage_metrics", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t size = metrics.ByteSizeLong();
+    if (size == 0) {
+        return fd;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    bool ok = metrics.SerializeToArray(data, static_cast<int>(size));
+    munmap(data, size);
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Parse a MetricsBuffer out of a memfd from write_metrics_memfd. The size
+ * comes from the memfd itself, never from the message that carried it.
+ */
+bool read_metrics_memfd(int fd, presage::physiology::MetricsBuffer* metrics) {
+    struct stat fd_stat;
+    if (fstat(fd, &fd_stat) != 0) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(fd_stat.st_size);
+    if (size == 0) {
+        return metrics->ParseFromArray(nullptr, 0);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    bool ok = metrics->ParseFromArray(data, static_cast<int>(size));
+    munmap(data, size);
+    return ok;
+}
+
+/**
+ * One SDK worker: a copy of this daemon started with --sdk-worker and
+ * connected over a SOCK_SEQPACKET socketpair. Jobs go down as JSON
+ * messages. Metrics, status changes and completion come back the same
+ * way, with each metrics buffer attached as a memfd.
+ * 
+ * A crash, a hang or a blown memory limit takes down only the child. The
+ * owner kills it and spawns a fresh one for the next job.
+ */
+class SdkWorkerProcess {
+public:
+    static constexpr int kChannelFd = 3;  // The socket's fd inside the worker
+    static constexpr size_t kMaxMessageBytes = 64 * 1024;
+    
+    enum class ReceiveResult {
+        kMessage,
+        kTimeout,
+        kClosed,  // The worker exited or the channel broke
+    };
+    
+    explicit SdkWorkerProcess(size_t memory_limit_mb) : memory_limit_mb_(memory_limit_mb) {}
+    
+    ~SdkWorkerProcess() {
+        terminate();
+    }
+    
+    SdkWorkerProcess(const SdkWorkerProcess&) = delete;
+    SdkWorkerProcess& operator=(const SdkWorkerProcess&) = delete;
+    
+    bool alive() const { return pid_ > 0; }
+    
+    /**
+     * Fork and exec a worker. It dies with the thread that spawned it
+     * (PR_SET_PDEATHSIG), so a crashed daemon leaves no orphans.
+     */
+    bool spawn() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+            LOG(ERROR) << "SDK worker socketpair failed: " << strerror(errno);
+            return false;
+        }
+        
+        // Everything the child needs is prepared here: after fork it may only
+        // make async-signal-safe calls
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(memory_limit_mb_) * 1024 * 1024;
+        pid_t parent = getpid();
+        
+        pid_t pid = fork();
+        if (pid < 0) {
+            LOG(ERROR) << "SDK worker fork failed: " << strerror(errno);
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            if (fds[1] == kChannelFd) {
+                fcntl(kChannelFd, F_SETFD, 0);
+            } else {
+                dup2(fds[1], kChannelFd);
+            }
+#ifdef SYS_close_range
+            syscall(SYS_close_range, kChannelFd + 1, ~0U, 0);  // Listening sockets, recordings
+#endif
+            if (memory_limit_mb_ > 0) {
+                setrlimit(RLIMIT_AS, &limit);
+            }
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) {
+                _exit(1);
+            }
+            execl("/proc/self/exe", "presage_daemon", "--sdk-worker", static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        
+        close(fds[1]);
+        pid_ = pid;
+        fd_ = fds[0];
+        g_stats.sdk_worker_spawns++;
+        LOG(INFO) << "Started SDK worker process " << pid_;
+        return true;
+    }
+    
+    /**
+     * Kill and reap the worker.
+     * 
+     * @return Its wait status, or -1 if there was no worker
+     */
+    int terminate() {
+        if (pid_ <= 0) {
+            return -1;
+        }
+        kill(pid_, SIGKILL);
+        int status = 0;
+        waitpid(pid_, &status, 0);
+        close(fd_);
+        pid_ = -1;
+        fd_ = -1;
+        return status;
+    }
+    
+    bool send(const json& message) {
+        return sendMessage(fd_, message);
+    }
+    
+    /**
+     * Wait up to timeout_ms (-1 = forever) for the worker's next message.
+     */
+    ReceiveResult receive(json& message, int& attached_fd, int timeout_ms) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        int ready;
+        do {
+            ready = poll(&pfd, 1, timeout_ms);
+        } while (ready < 0 && errno == EINTR);
+        if (ready == 0) {
+            return ReceiveResult::kTimeout;
+        }
+        return receiveMessage(fd_, message, attached_fd) > 0 ? ReceiveResult::kMessage : ReceiveResult::kClosed;
+    }
+    
+    /**
+     * Send one message, optionally passing a file descriptor along with it.
+     */
+    static bool sendMessage(int fd, const json& message, int attached_fd = -1) {
+        std::string payload = message.dump();
+        struct iovec iov;
+        iov.iov_base = payload.data();
+        iov.iov_len = payload.size();
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        if (attached_fd >= 0) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &attached_fd, sizeof(int));
+        }
+        return sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(payload.size());
+    }
+    
+    /**
+     * Receive one message. attached_fd is set to a passed descriptor (which
+     * the caller must close), or -1.
+     * 
+     * @return Message size, 0 when the peer closed, -1 on error
+     */
+    static ssize_t receiveMessage(int fd, json& message, int& attached_fd) {
+        attached_fd = -1;
+        std::vector<char> buffer(kMaxMessageBytes);
+        struct iovec iov;
+        iov.iov_base = buffer.data();
+        iov.iov_len = buffer.size();
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        ssize_t received = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (received <= 0) {
+            return received;
+        }
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(&attached_fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+        message = json::parse(buffer.data(), buffer.data() + received, nullptr, false);
+        if (message.is_discarded()) {
+            if (attached_fd >= 0) {
+                close(attached_fd);
+                attached_fd = -1;
+            }
+            return -1;
+        }
+        return received;
+    }
+    
+private:
+    size_t memory_limit_mb_;
+    pid_t pid_ = -1;
+    int fd_ = -1;
+};
+
+/**
+ * Run one job inside a worker: the same SDK pass as an in-process segment
+ * run, with every callback forwarded to the daemon instead of broadcast.
+ * 
+ * @param run_ok Set to false if Run() failed with a real (non-cancel) error
+ * @return false if the SDK could not be set up
+ */
+bool run_sdk_worker_job(int fd, const json& job, const std::string& api_key, bool* run_ok) {
+    std::string video_path = job.value("video_path", "");
+    try {
+        auto container = std::make_unique<container::CpuContinuousRestForegroundContainer>(
+            make_segment_sdk_settings(video_path, api_key, job.value("frame_width", 1280),
+                                      job.value("frame_height", 720)));
+        
+        auto metrics_status = container->SetOnCoreMetricsOutput(
+            [fd](const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+                int metrics_fd = write_metrics_memfd(metrics);
+                if (metrics_fd < 0) {
+                    return absl::InternalError("cannot share metrics buffer");
+                }
+                json message;
+                message["type"] = "metrics";
+                message["timestamp"] = timestamp;
+                bool sent = SdkWorkerProcess::sendMessage(fd, message, metrics_fd);
+                close(metrics_fd);
+                return sent ? absl::OkStatus() : absl::CancelledError("daemon went away");
+            }
+        );
+        if (!metrics_status.ok()) {
+            LOG(ERROR) << "Failed to set SDK metrics callback: " << metrics_status.message();
+            return false;
+        }
+        
+        // The daemon replays the same status sequence (and the frame that
+        // ran the watch out) through its own watch, so both sides agree on
+        // whether the run was aborted
+        ImagingStatusWatch status_watch(job.value("bad_status_abort_seconds", 0.0));
+        auto status_callback_status = container->SetOnStatusChange(
+            [fd, &status_watch](presage::physiology::StatusValue imaging_status) {
+                json message;
+                message["type"] = "status";
+                message["code"] = static_cast<int>(imaging_status.value());
+                message["timestamp"] = imaging_status.timestamp();
+                if (!SdkWorkerProcess::sendMessage(fd, message)) {
+                    return absl::CancelledError("daemon went away");
+                }
+                if (status_watch.update(static_cast<int>(imaging_status.value()), imaging_status.timestamp())) {
+                    return absl::CancelledError("imaging status unusable");
+                }
+                return absl::OkStatus();
+            }
+        );
+        if (!status_callback_status.ok()) {
+            LOG(WARNING) << "Failed to set SDK status callback: " << status_callback_status.message();
+        }
+        auto video_output_status = container->SetOnVideoOutput(
+            [fd, &status_watch](cv::Mat&, int64_t timestamp) {
+                if (status_watch.aborted() || !status_watch.tick(timestamp)) {
+                    return absl::OkStatus();
+                }
+                json message;
+                message["type"] = "status_tick";
+                message["timestamp"] = timestamp;
+                SdkWorkerProcess::sendMessage(fd, message);
+                return absl::CancelledError("imaging status unusable");
+            }
+        );
+        if (!video_output_status.ok()) {
+            LOG(WARNING) << "Failed to set SDK video output callback: " << video_output_status.message();
+        }
+        
+        if (auto init_status = container->Initialize(); !init_status.ok()) {
+            LOG(ERROR) << "Failed to initialize SDK for segment: " << init_status.message();
+            return false;
+        }
+        json initialized;
+        initialized["type"] = "initialized";
+        SdkWorkerProcess::sendMessage(fd, initialized);
+        
+        if (auto run_status = container->Run(); !run_status.ok()) {
+            if (!absl::IsCancelled(run_status)) {
+                LOG(ERROR) << "SDK segment processing error: " << run_status.message();
+                *run_ok = false;
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        LOG(ERROR) << "SDK segment processing exception: " << e.what();
+        return false;
+    }
+}
+
+/**
+ * Main loop of a `presage_daemon --sdk-worker` process: one job at a time
+ * until the daemon closes the channel.
+ */
+int run_sdk_worker(const std::string& api_key) {
+    int fd = SdkWorkerProcess::kChannelFd;
+    json job;
+    int attached_fd = -1;
+    while (SdkWorkerProcess::receiveMessage(fd, job, attached_fd) > 0) {
+        if (attached_fd >= 0) {
+            close(attached_fd);
+        }
+        json done;
+        done["type"] = "done";
+        bool run_ok = true;
+        done["ok"] = run_sdk_worker_job(fd, job, api_key, &run_ok);
+        done["run_ok"] = run_ok;
+        if (!SdkWorkerProcess::sendMessage(fd, done)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * SDKVideoProcessor runs the SmartSpectra SDK on recorded video files
+ * and broadcasts the resulting metrics via the MetricsServer.
+ * 
+ * Supports processing video segments in a queue for real-time metrics.
+ * Processing happens in background threads so it doesn't block
+ * the video input server from accepting new sessions.
+ * 
+ * With worker processes, segments are spread over one lane per worker,
+ * each with its own queue and dispatch thread. A session always maps to
+ * the same lane, so its segments stay in order and a short tail can
+ * still merge with the segment before it.
+ */
+class SDKVideoProcessor {
+public:
+    /**
+     * What to do with a segment shorter than min_segment_frames (normally the
+     * tail written at session end), which the SDK can't get valid metrics from.
+     */
+    enum class TailPolicy {
+        kProcess,  // Run it anyway
+        kMerge,    // Prepend the end of the session's previous segment
+        kSkip,     // Drop it with a segment_skipped status
+    };
+    
+    struct ProcessingJob {
+        std::string video_path;
+        std::string session_id;
+        size_t segment_index;
+        bool is_segment;  // true for segments, false for final processing
+        PipelineTimestamps timestamps;
+        SegmentEncodeStats encode_stats;
+        uint64_t journal_id = 0;  // 0 when journaling is off
+    };
+
+    /**
+     * @param worker_processes Run segments in this many SDK worker processes
+     *                         (0 = on a thread inside the daemon). Each idle
+     *                         worker takes the next segment, whatever its session.
+     * @param worker_memory_limit_mb Address-space limit per worker (0 = none)
+     */
+    SDKVideoProcessor(const std::string& api_key, int frame_width, int frame_height,
+                      size_t worker_processes = 0, size_t worker_memory_limit_mb = 0)
+        : api_key_(api_key), frame_width_(frame_width), frame_height_(frame_height),
+          worker_processes_(worker_processes), worker_memory_limit_mb_(worker_memory_limit_mb),
+          processing_(false), shutdown_(false) {
+        // Start a worker thread per lane; all lanes drain the shared queue
+        size_t lane_count = std::max<size_t>(1, worker_processes_);
+        for (size_t i = 0; i < lane_count; ++i) {
+            lanes_.push_back(std::make_unique<Lane>());
+            lanes_.back()->index = i;
+        }
+        for (auto& lane : lanes_) {
+            lane->thread = std::thread(&SDKVideoProcessor::processingWorker, this, lane.get());
+        }
+    }
+    
+    ~SDKVideoProcessor() {
+        shutdown();
+    }
+    
+    /**
+     * Configure short-segment handling. Call before queueing work.
+     */
+    void setTailPolicy(TailPolicy policy, size_t min_segment_frames) {
+        tail_policy_ = policy;
+        min_segment_frames_ = min_segment_frames;
+    }
+    
+    /**
+     * Skip segments whose sampled frames had a face less often than this
+     * fraction. Call before queueing work.
+     */
+    void setFaceGate(double min_coverage) {
+        face_gate_coverage_ = min_coverage;
+    }
+    
+    /**
+     * Stop SDK runs once imaging status has been unusable for this many
+     * seconds of video (0 = run to the end). Call before queueing work.
+     */
+    void setBadStatusAbort(double seconds) {
+        bad_status_abort_seconds_ = seconds;
+    }
+    
+    /**
+     * Give each SDK job max(min_seconds, factor x its segment duration) to
+     * finish (factor 0 = no deadline). Call before queueing work.
+     */
+    void setJobDeadline(double factor, int min_seconds) {
+        job_deadline_factor_ = factor;
+        job_deadline_min_seconds_ = min_seconds;
+    }
+    
+    /**
+     * Shutdown the processor and wait for pending jobs.
+     */
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            shutdown_ = true;
+        }
+        queue_cv_.notify_all();
+        
+        for (auto& lane : lanes_) {
+            if (lane->thread.joinable()) {
+                lane->thread.join();
+            }
+        }
+        joinAbandonedRunners();
+    }
+    
+    /**
+     * Queue a video segment for processing.
+     * Used for real-time segment processing during a session.
+     * 
+     * @param video_path Path to the segment video file
+     * @param session_id Session identifier
+     * @param segment_index Segment index within the session
+     * @param timestamps Pipeline stamps collected while recording the segment
+     * @param encode_stats Codec, encode CPU and size of the segment file
+     * @param journal_id Existing journal entry (resumed job), or 0 to journal it now
+     */
+    void queueSegment(const std::string& video_path, const std::string& session_id, 
+                      size_t segment_index, const PipelineTimestamps& timestamps = {},
+                      const SegmentEncodeStats& encode_stats = {}, uint64_t journal_id = 0) {
+        if (journal_id == 0 && g_segment_journal) {
+            journal_id = g_segment_journal->recordEnqueue(session_id, segment_index, video_path);
+        }
+        if (g_recording_janitor) {
+            g_recording_janitor->acquire(video_path);
+        }
+        
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        
+        ProcessingJob job;
+        job.video_path = video_path;
+        job.session_id = session_id;
+        job.segment_index = segment_index;
+        job.is_segment = true;
+        job.timestamps = timestamps;
+        job.encode_stats = encode_stats;
+        job.journal_id = journal_id;
+        
+        queue_.push_back(job);
+        
+        LOG(INFO) << "Queued segment " << segment_index << " for session " << session_id
+                  << " (queue size: " << queue_.size() << ")";
+        
+        queue_cv_.notify_all();
+    }
+    
+    /**
+     * Process a recorded video file using the SmartSpectra SDK.
+     * Runs in a background thread.
+     * 
+     * @param video_path Path to the recorded video file
+     * @param session_id Session identifier for logging
+     * @return true if processing was started, false if already processing
+     */
+    bool processVideoAsync(const std::string& video_path, const std::string& session_id) {
+        // Check if already processing
+        if (processing_.load()) {
+            LOG(WARNING) << "SDK already processing another video";
+            return false;
+        }
+        
+        // Wait for any previous processing thread to complete
+        waitForCompletion();
+        
+        // Start new processing thread
+        processing_ = true;
+        current_session_id_ = session_id;
+        
+        processing_thread_ = std::thread(&SDKVideoProcessor::processVideo, this, 
+                                         video_path, session_id);
+        
+        LOG(INFO) << "Started SDK processing for session " << session_id 
+                  << " in background thread";
+        return true;
+    }
+    
+    /**
+     * Check if SDK processing is currently in progress.
+     */
+    bool isProcessing() const {
+        return processing_.load();
+    }
+    
+    /**
+     * Number of segments waiting for the SDK workers.
+     */
+    size_t queueDepth() {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        return queue_.size();
+    }
+    
+    /**
+     * Seconds the longest-running SDK job has been going (0 when idle).
+     */
+    double currentJobSeconds() const {
+        int64_t started_ns = 0;
+        for (const auto& lane : lanes_) {
+            int64_t lane_started_ns = lane->job_started_ns.load();
+            if (lane_started_ns != 0 && (started_ns == 0 || lane_started_ns < started_ns)) {
+                started_ns = lane_started_ns;
+            }
+        }
+        if (started_ns == 0) {
+            return 0.0;
+        }
+        auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            PipelineTimestamps::Clock::now().time_since_epoch()).count();
+        return (now_ns - started_ns) / 1e9;
+    }
+    
+    /**
+     * Get the current session being processed.
+     */
+    std::string getCurrentSessionId() const {
+        return current_session_id_;
+    }
+    
+    /**
+     * Wait for the current processing to complete.
+     */
+    void waitForCompletion() {
+        if (processing_thread_.joinable()) {
+            processing_thread_.join();
+        }
+    }
+    
+private:
+    struct Runner;
+    
+    /**
+     * One queue and the thread draining it, plus what that thread keeps
+     * between jobs.
+     */
+    struct Lane {
+        size_t index = 0;
+        std::thread thread;
+        
+        // Steady-clock start of the job the lane is running (0 when idle)
+        std::atomic<int64_t> job_started_ns{0};
+        
+        // Job the lane is running, guarded by queue_mutex_ (holds back tails)
+        bool active = false;
+        std::string active_session;
+        size_t active_index = 0;
+        
+        // Lane thread only
+        std::shared_ptr<Runner> runner;             // In-process runs
+        std::unique_ptr<SdkWorkerProcess> process;  // Worker process runs
+    };
+    
+    /**
+     * A short segment the merge policy will join with its predecessor.
+     * Frame count is unknown (0) for jobs resumed from the journal.
+     */
+    bool isShortSegment(const ProcessingJob& job) const {
+        return min_segment_frames_ > 0 && job.encode_stats.frames > 0 &&
+               job.encode_stats.frames < min_segment_frames_;
+    }
+    
+    /**
+     * Position in queue_ of the first job a lane may start. Full-length
+     * segments can run on any lane in any order; only a tail to be merged
+     * waits while an earlier segment of its session is queued or running,
+     * so it finds its predecessor held. Caller holds queue_mutex_.
+     */
+    std::optional<size_t> nextRunnableLocked() const {
+        for (size_t i = 0; i < queue_.size(); ++i) {
+            const ProcessingJob& job = queue_[i];
+            if (tail_policy_ != TailPolicy::kMerge || !isShortSegment(job)) {
+                return i;
+            }
+            bool waiting = false;
+            for (const auto& other : queue_) {
+                waiting |= other.session_id == job.session_id && other.segment_index < job.segment_index;
+            }
+            for (const auto& lane : lanes_) {
+                waiting |= lane->active && lane->active_session == job.session_id &&
+                           lane->active_index < job.segment_index;
+            }
+            if (!waiting) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+    
+    /**
+     * Worker thread that takes segments off the shared queue.
+     */
+    void processingWorker(Lane* lane_ptr) {
+        Lane& lane = *lane_ptr;
+        LOG(INFO) << "SDK processing worker " << lane.index << " started";
+        PipelineTracer::instance().setThreadName(
+            lanes_.size() > 1 ? "sdk_worker_" + std::to_string(lane.index) : "sdk_worker");
+        
+        while (true) {
+            ProcessingJob job;
+            
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                
+                // Wait for a runnable job, or shutdown once the queue is drained
+                std::optional<size_t> next;
+                queue_cv_.wait(lock, [this, &next]() {
+                    next = nextRunnableLocked();
+                    return next || (shutdown_ && queue_.empty());
+                });
+                
+                if (!next) {
+                    break;
+                }
+                
+                job = queue_[*next];
+                queue_.erase(queue_.begin() + static_cast<std::ptrdiff_t>(*next));
+                lane.active = true;
+                lane.active_session = job.session_id;
+                lane.active_index = job.segment_index;
+            }
+            job.timestamps.job_dequeued = PipelineTimestamps::Clock::now();
+            double wait_ms = stage_ms(job.timestamps.segment_finalized, job.timestamps.job_dequeued);
+            if (wait_ms >= 0.0) {
+                g_stats.job_wait_seconds.observe(wait_ms / 1000.0);
+                PipelineTracer::instance().record("queue_wait", job.timestamps.segment_finalized,
+                                                  job.timestamps.job_dequeued,
+                                                  static_cast<int64_t>(job.segment_index));
+            }
+            
+            // Process the segment
+            LOG(INFO) << "Processing segment " << job.segment_index 
+                      << " for session " << job.session_id;
+            
+            lane.job_started_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                job.timestamps.job_dequeued.time_since_epoch()).count();
+            if (g_segment_journal && job.journal_id != 0) {
+                g_segment_journal->recordStart(job.journal_id);
+            }
+            
+            bool is_short = isShortSegment(job);
+            bool no_face = face_gate_coverage_ > 0.0 && job.encode_stats.face_samples > 0 &&
+                           job.encode_stats.faceCoverage() < face_gate_coverage_;
+            bool ok = false;
+            bool retry = false;  // The SDK run failed; a restart should pick the job up again
+            if (no_face) {
+                g_stats.segments_no_face++;
+                broadcastSegmentSkipped(job, "no_face");
+            } else if (!is_short || tail_policy_ == TailPolicy::kProcess) {
+                ok = runWithDeadline(lane, job, job.video_path);
+                retry = !ok;
+            } else if (std::optional<ProcessingJob> source = takeMergeSource(job.session_id)) {
+                std::string merged_path = mergeTail(*source, job);
+                releaseProcessed(*source);  // Its frames are copied, or the merge failed
+                if (!merged_path.empty()) {
+                    if (g_recording_janitor) {
+                        g_recording_janitor->acquire(merged_path);
+                    }
+                    ok = runWithDeadline(lane, job, merged_path);
+                    retry = !ok;
+                    if (g_recording_janitor) {
+                        g_recording_janitor->release(merged_path);
+                    }
+                    if (ok) {
+                        // The merged file supersedes the tail the journal points at
+                        remove_segment_files(job.video_path);
+                        if (g_recording_janitor) {
+                            g_recording_janitor->segmentProcessed(merged_path);
+                        }
+                    } else {
+                        remove_segment_files(merged_path);  // The tail stays for a retry
+                    }
+                } else {
+                    broadcastSegmentSkipped(job, "merge_failed");
+                }
+            } else {
+                broadcastSegmentSkipped(job, "too_few_frames");
+            }
+            
+            // Skips are final. A failed run stays open in the journal, so the
+            // next start resumes it (at most SegmentJournal::kMaxStarts times).
+            if (g_segment_journal && job.journal_id != 0 && !retry) {
+                g_segment_journal->recordComplete(job.journal_id);
+            }
+            if (g_quality_controller && ok) {
+                double run_ms = stage_ms(job.timestamps.job_dequeued, PipelineTimestamps::Clock::now());
+                double media_ms = stage_ms(job.timestamps.first_frame_received, job.timestamps.last_frame_received);
+                g_quality_controller->observeJob(run_ms / 1000.0, media_ms / 1000.0, queueDepth(),
+                                                 job.encode_stats.quality_level);
+            }
+            retireSegment(job, ok, !is_short);
+            lane.job_started_ns = 0;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                lane.active = false;
+            }
+            queue_cv_.notify_all();  // A tail may have been waiting on this job
+        }
+        
+        stopRunner(lane);
+        lane.process.reset();
+        LOG(INFO) << "SDK processing worker " << lane.index << " stopped";
+    }
+    
+    /**
+     * Thread that runs SDK jobs for the worker one at a time, so the worker
+     * can stop waiting on a stuck one. Shared, so a runner that has been
+     * abandoned mid-job can finish (or hang) on its own.
+     */
+    struct Runner {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::function<bool()> task;
+        bool has_task = false;
+        bool done = false;
+        bool ok = false;
+        bool stop = false;
+        std::atomic<bool> cancelled{false};
+        std::thread thread;
+    };
+    
+    static void runnerLoop(std::shared_ptr<Runner> runner) {
+        PipelineTracer::instance().setThreadName("sdk_runner");
+        std::unique_lock<std::mutex> lock(runner->mutex);
+        while (true) {
+            runner->cv.wait(lock, [&runner]() { return runner->stop || runner->has_task; });
+            if (!runner->has_task) {
+                break;
+            }
+            std::function<bool()> task = std::move(runner->task);
+            runner->has_task = false;
+            lock.unlock();
+            bool ok = task();
+            lock.lock();
+            runner->ok = ok;
+            runner->done = true;
+            runner->cv.notify_all();
+        }
+    }
+    
+    /**
+     * Give runners abandoned on a stuck SDK call a bounded chance to finish
+     * before the processor goes away. One still stuck after that is
+     * detached. Its task was cancelled, so when the call returns it touches
+     * nothing of the processor's (see processVideoSegment).
+     */
+    void joinAbandonedRunners() {
+        std::lock_guard<std::mutex> abandoned_lock(abandoned_mutex_);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kAbandonedJoinSeconds);
+        for (auto& runner : abandoned_runners_) {
+            bool finished;
+            {
+                std::unique_lock<std::mutex> lock(runner->mutex);
+                finished = runner->cv.wait_until(lock, deadline, [&runner]() { return runner->done; });
+            }
+            if (finished) {
+                runner->thread.join();
+            } else {
+                LOG(WARNING) << "Abandoned SDK runner still stuck at shutdown; detaching it";
+                runner->thread.detach();
+            }
+        }
+        abandoned_runners_.clear();
+    }
+    
+    void stopRunner(Lane& lane) {
+        if (!lane.runner) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(lane.runner->mutex);
+            lane.runner->stop = true;
+        }
+        lane.runner->cv.notify_all();
+        lane.runner->thread.join();
+        lane.runner.reset();
+    }
+    
+    /**
+     * Watchdog deadline for a job: max(min, factor x its capture time), or
+     * 0 when the watchdog is off.
+     */
+    double jobDeadlineSeconds(const ProcessingJob& job) const {
+        if (job_deadline_factor_ <= 0.0) {
+            return 0.0;
+        }
+        double media_seconds = stage_ms(job.timestamps.first_frame_received, job.timestamps.last_frame_received) / 1000.0;
+        if (media_seconds <= 0.0) {
+            media_seconds = kUnknownMediaSeconds;  // Resumed jobs carry no capture stamps
+        }
+        return std::max(static_cast<double>(job_deadline_min_seconds_), job_deadline_factor_ * media_seconds);
+    }
+    
+    /**
+     * Run the SDK on a job's video under the watchdog. The deadline scales
+     * with the segment's capture time. When it passes, the run is asked to
+     * cancel (its callbacks start returning Cancelled). A run that doesn't
+     * return within a grace period is blocked somewhere the SDK can't be
+     * interrupted, such as a hung REST call. Its runner thread is then
+     * abandoned and the next job gets a fresh one.
+     * 
+     * With worker processes the job goes to the lane's worker instead.
+     * Video the SDK has already processed is replayed from the result cache
+     * without running it at all.
+     * 
+     * @return true if the SDK ran to completion in time
+     */
+    bool runWithDeadline(Lane& lane, const ProcessingJob& job, const std::string& video_path) {
+        uint64_t cache_key = 0;
+        if (g_sdk_result_cache) {
+            cache_key = g_sdk_result_cache->keyFor(video_path, sdkCacheFingerprint(true));
+            if (cache_key != 0 && replayCachedSegment(job, video_path, cache_key)) {
+                return true;
+            }
+        }
+        if (worker_processes_ > 0) {
+            return runInWorkerProcess(lane, job, video_path, cache_key);
+        }
+        double deadline_seconds = jobDeadlineSeconds(job);
+        if (deadline_seconds <= 0.0) {
+            return processVideoSegment(video_path, job.session_id, job.segment_index, job.timestamps,
+                                       job.encode_stats, cache_key);
+        }
+        
+        if (!lane.runner) {
+            lane.runner = std::make_shared<Runner>();
+            lane.runner->thread = std::thread(&SDKVideoProcessor::runnerLoop, lane.runner);
+        }
+        std::shared_ptr<Runner> runner = lane.runner;
+        Runner* raw = runner.get();
+        {
+            std::lock_guard<std::mutex> lock(runner->mutex);
+            runner->cancelled = false;
+            runner->done = false;
+            runner->task = [this, job, video_path, cache_key, raw]() {
+                return processVideoSegment(video_path, job.session_id, job.segment_index, job.timestamps,
+                                           job.encode_stats, cache_key, &raw->cancelled);
+            };
+            runner->has_task = true;
+        }
+        runner->cv.notify_all();
+        
+        auto is_done = [raw]() { return raw->done; };
+        
+        std::unique_lock<std::mutex> lock(runner->mutex);
+        if (runner->cv.wait_for(lock, std::chrono::duration<double>(deadline_seconds), is_done)) {
+            return runner->ok;
+        }
+        
+        runner->cancelled = true;
+        g_stats.sdk_jobs_timed_out++;
+        bool stopped = runner->cv.wait_for(lock, std::chrono::seconds(kCancelGraceSeconds), is_done);
+        if (!stopped) {
+            runner->stop = true;  // Exits once the stuck call returns, if it ever does
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> abandoned_lock(abandoned_mutex_);
+                abandoned_runners_.push_back(runner);
+            }
+            lane.runner.reset();
+            g_stats.sdk_runners_abandoned++;
+        }
+        
+        LOG(ERROR) << "SDK job for segment " << job.segment_index << " of session " << job.session_id
+                   << " passed its " << deadline_seconds << "s deadline"
+                   << (stopped ? " and was cancelled" : "; abandoning its runner thread");
+        broadcastJobError(job, "SDK job exceeded its deadline", "deadline",
+                          {{"deadline_seconds", deadline_seconds}, {"abandoned", !stopped}});
+        return false;
+    }
+    
+    /**
+     * Run a job in the lane's worker process and replay its callbacks here,
+     * so clients get the same messages as from an in-process run. Past the
+     * deadline the worker is killed outright, which needs no cooperation
+     * from the SDK. A worker that dies mid-job fails only that job. Either
+     * way the next job spawns a fresh worker.
+     * 
+     * @return true if the SDK ran to completion in time
+     */
+    bool runInWorkerProcess(Lane& lane, const ProcessingJob& job, const std::string& video_path,
+                            uint64_t cache_key) {
+        LOG(INFO) << "SDK segment processing started for: " << video_path << " (worker " << lane.index << ")";
+        broadcastSegmentProcessing(video_path, job.session_id, job.segment_index, job.timestamps);
+        
+        if (!lane.process) {
+            lane.process = std::make_unique<SdkWorkerProcess>(worker_memory_limit_mb_);
+        }
+        if (!lane.process->alive() && !lane.process->spawn()) {
+            broadcastJobError(job, "Failed to start SDK worker process", "worker_spawn");
+            return false;
+        }
+        
+        json request;
+        request["type"] = "job";
+        request["video_path"] = video_path;
+        request["frame_width"] = frame_width_;
+        request["frame_height"] = frame_height_;
+        request["bad_status_abort_seconds"] = bad_status_abort_seconds_;
+        auto init_started = PipelineTimestamps::Clock::now();
+        bool sent = lane.process->send(request);
+        
+        SegmentRun run(job.session_id, job.segment_index, job.timestamps, bad_status_abort_seconds_);
+        run.cache_key = cache_key;
+        double deadline_seconds = jobDeadlineSeconds(job);
+        auto deadline = init_started + std::chrono::duration_cast<PipelineTimestamps::Clock::duration>(
+            std::chrono::duration<double>(deadline_seconds));
+        
+        while (sent) {
+            int timeout_ms = -1;
+            if (deadline_seconds > 0.0) {
+                timeout_ms = static_cast<int>(std::max<int64_t>(0,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - PipelineTimestamps::Clock::now()).count()));
+            }
+            json message;
+            int attached_fd = -1;
+            auto result = lane.process->receive(message, attached_fd, timeout_ms);
+            if (result == SdkWorkerProcess::ReceiveResult::kTimeout) {
+                lane.process->terminate();
+                g_stats.sdk_jobs_timed_out++;
+                LOG(ERROR) << "SDK job for segment " << job.segment_index << " of session " << job.session_id
+                           << " passed its " << deadline_seconds << "s deadline; killed worker " << lane.index;
+                broadcastJobError(job, "SDK job exceeded its deadline", "deadline",
+                                  {{"deadline_seconds", deadline_seconds}, {"abandoned", false}});
+                return false;
+            }
+            if (result == SdkWorkerProcess::ReceiveResult::kClosed) {
+                break;
+            }
+            
+            std::string type = message.value("type", "");
+            if (type == "metrics" && attached_fd >= 0) {
+                presage::physiology::MetricsBuffer metrics;
+                if (read_metrics_memfd(attached_fd, &metrics)) {
+                    onSegmentMetrics(run, metrics, message.value("timestamp", int64_t{0}));
+                } else {
+                    LOG(WARNING) << "Unreadable metrics buffer from SDK worker " << lane.index;
+                }
+            } else if (type == "status") {
+                onSegmentStatus(run, message.value("code", 0), message.value("timestamp", int64_t{0}));
+            } else if (type == "status_tick") {
+                onSegmentFrame(run, message.value("timestamp", int64_t{0}));
+            } else if (type == "initialized") {
+                onSegmentInitialized(run, init_started);
+            } else if (type == "done") {
+                if (!message.value("ok", false)) {
+                    return false;  // The worker logged why
+                }
+                run.run_ok = message.value("run_ok", true);
+                onSegmentRunCompleted(run);
+                reportSegmentCompleted(run, job.encode_stats);
+                return run.run_ok;  // A failed run stays journaled for a retry
+            }
+            if (attached_fd >= 0) {
+                close(attached_fd);
+            }
+        }
+        
+        int wait_status = lane.process->terminate();
+        g_stats.sdk_worker_crashes++;
+        std::string cause = WIFSIGNALED(wait_status) ? "signal " + std::to_string(WTERMSIG(wait_status))
+                                                     : "exit code " + std::to_string(WEXITSTATUS(wait_status));
+        LOG(ERROR) << "SDK worker " << lane.index << " died during segment " << job.segment_index
+                   << " of session " << job.session_id << " (" << cause << ")";
+        broadcastJobError(job, "SDK worker process died (" + cause + ")", "worker_crashed");
+        return false;
+    }
+    
+    /**
+     * Everything besides the video itself that shapes SDK output. Bump the
+     * version when the SDK settings in make_segment_sdk_settings or
+     * processVideo change.
+     */
+    std::string sdkCacheFingerprint(bool segment) const {
+        std::ostringstream fingerprint;
+        fingerprint << "v1 " << (segment ? "segment" : "recording") << " " << frame_width_ << "x"
+                    << frame_height_ << " abort=" << bad_status_abort_seconds_;
+        return fingerprint.str();
+    }
+    
+    /**
+     * Broadcast a segment's stored SDK output as if the SDK had just
+     * produced it.
+     * 
+     * @return false on a cache miss
+     */
+    bool replayCachedSegment(const ProcessingJob& job, const std::string& video_path, uint64_t cache_key) {
+        std::vector<SdkResultCache::Record> records;
+        if (!g_sdk_result_cache->load(cache_key, &records)) {
+            return false;
+        }
+        LOG(INFO) << "SDK result cache hit for segment " << job.segment_index << " of session "
+                  << job.session_id << " (" << records.size() << " callbacks)";
+        broadcastSegmentProcessing(video_path, job.session_id, job.segment_index, job.timestamps);
+        
+        SegmentRun run(job.session_id, job.segment_index, job.timestamps, bad_status_abort_seconds_);
+        run.cached = true;
+        run.timestamps.sdk_initialized = PipelineTimestamps::Clock::now();
+        SdkResultCache::replay(records,
+            [this, &run](const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+                onSegmentMetrics(run, metrics, timestamp);
+            },
+            [this, &run](int status_code, int64_t timestamp) {
+                onSegmentStatus(run, status_code, timestamp);
+            });
+        run.timestamps.run_completed = PipelineTimestamps::Clock::now();
+        reportSegmentCompleted(run, job.encode_stats);
+        return true;
+    }
+    
+    /**
+     * Hand a finished job's file back to the retention janitor. Under the
+     * merge policy the latest processed full segment is held back (still
+     * pinned, not yet deletable) in case the session's next job is a short
+     * tail that needs its frames. A later job of the same session, or any
+     * job of another session, lets it go. Segments that finish out of order
+     * never displace a later held one.
+     */
+    void retireSegment(const ProcessingJob& job, bool processed, bool full_length) {
+        std::optional<ProcessingJob> superseded;
+        bool held = false;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (merge_source_ && (merge_source_->session_id != job.session_id ||
+                                  merge_source_->segment_index < job.segment_index)) {
+                superseded = std::move(merge_source_);
+                merge_source_.reset();
+            }
+            if (processed && full_length && tail_policy_ == TailPolicy::kMerge && !merge_source_) {
+                merge_source_ = job;
+                held = true;
+            }
+        }
+        if (superseded) {
+            releaseProcessed(*superseded);
+        }
+        if (held) {
+            return;
+        }
+        if (g_recording_janitor) {
+            g_recording_janitor->release(job.video_path);
+            if (processed) {
+                g_recording_janitor->segmentProcessed(job.video_path);
+            }
+        }
+    }
+    
+    /**
+     * Take the held segment for a tail merge, if it belongs to the session.
+     * The caller then owns its pin.
+     */
+    std::optional<ProcessingJob> takeMergeSource(const std::string& session_id) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!merge_source_ || merge_source_->session_id != session_id) {
+            return std::nullopt;
+        }
+        std::optional<ProcessingJob> source = std::move(merge_source_);
+        merge_source_.reset();
+        return source;
+    }
+    
+    /**
+     * Unpin a processed segment and offer it to the janitor. Unpin first, or
+     * the janitor may see it still in use and drop it.
+     */
+    void releaseProcessed(const ProcessingJob& job) {
+        if (g_recording_janitor) {
+            g_recording_janitor->release(job.video_path);
+            g_recording_janitor->segmentProcessed(job.video_path);
+        }
+    }
+    
+    /**
+     * Build a segment holding the last frames of `previous` followed by all of
+     * `tail`, so the total reaches min_segment_frames. Written next to the
+     * tail with the tail's codec, plus a merged frame time sidecar. The tail
+     * itself is left alone; the caller removes it once the merged run succeeds.
+     * 
+     * @return Path of the merged segment, or empty on failure (nothing left on disk)
+     */
+    std::string mergeTail(const ProcessingJob& previous, const ProcessingJob& tail) {
+        TraceSpan span("merge_tail", static_cast<int64_t>(tail.segment_index));
+        size_t needed = min_segment_frames_ - tail.encode_stats.frames;
+        
+        // First pass only counts frames (grab doesn't decode)
+        cv::VideoCapture source(previous.video_path);
+        if (!source.isOpened()) {
+            LOG(WARNING) << "Cannot reopen " << previous.video_path << " to merge tail";
+            return "";
+        }
+        size_t source_frames = 0;
+        while (source.grab()) {
+            source_frames++;
+        }
+        source.release();
+        needed = std::min(needed, source_frames);
+        size_t skip = source_frames - needed;
+        
+        std::string extension = recording_codec_extension(tail.encode_stats.codec);
+        std::string merged_path = tail.video_path.substr(0, tail.video_path.size() - extension.size()) +
+                                  "_merged" + extension;
+        std::unique_ptr<SegmentWriter> writer = make_segment_writer(tail.encode_stats.codec);
+        
+        cv::VideoCapture tail_source(tail.video_path);
+        int fps = static_cast<int>(tail_source.get(cv::CAP_PROP_FPS) + 0.5);
+        if (!tail_source.isOpened() || fps <= 0) {
+            LOG(WARNING) << "Cannot reopen tail " << tail.video_path << " to merge";
+            return "";
+        }
+        
+        source.open(previous.video_path);
+        cv::Mat frame;
+        for (size_t i = 0; i < skip; ++i) {
+            source.grab();
+        }
+        size_t written = 0;
+        cv::Size merged_size;
+        cv::Mat resized;
+        auto write_all = [&](cv::VideoCapture& capture) {
+            while (capture.read(frame)) {
+                if (!writer->isOpened()) {
+                    merged_size = frame.size();
+                    if (!writer->open(merged_path, fps, merged_size)) {
+                        return false;
+                    }
+                }
+                // Adaptive quality may have changed resolution between the two
+                if (frame.size() != merged_size) {
+                    cv::resize(frame, resized, merged_size, 0, 0, cv::INTER_AREA);
+                    writer->write(resized);
+                } else {
+                    writer->write(frame);
+                }
+                written++;
+            }
+            return true;
+        };
+        if (!write_all(source) || !write_all(tail_source)) {
+            LOG(WARNING) << "Failed to write merged segment " << merged_path;
+            writer->release();
+            remove_segment_files(merged_path);
+            return "";
+        }
+        writer->release();
+        
+        mergeTimestamps(previous.video_path, tail.video_path, merged_path, needed);
+        
+        LOG(INFO) << "Merged " << tail.encode_stats.frames << "-frame tail of session " << tail.session_id
+                  << " with " << needed << " frames of segment " << previous.segment_index
+                  << " -> " << merged_path << " (" << written << " frames)";
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = "segment_merged";
+            status_msg["session_id"] = tail.session_id;
+            status_msg["segment_index"] = tail.segment_index;
+            status_msg["merged_from_segment"] = previous.segment_index;
+            status_msg["merged_frames"] = needed;
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+        return merged_path;
+    }
+    
+    /**
+     * Join the frame time sidecars of a merge: the last `count` times of the
+     * previous segment, then the tail shifted to follow them by one frame gap.
+     */
+    void mergeTimestamps(const std::string& previous_path, const std::string& tail_path,
+                         const std::string& merged_path, size_t count) {
+        auto read_times = [](const std::string& path) {
+            std::vector<int64_t> times;
+            std::ifstream in(segment_timestamps_path(path));
+            int64_t time_us;
+            while (in >> time_us) {
+                times.push_back(time_us);
+            }
+            return times;
+        };
+        std::vector<int64_t> previous = read_times(previous_path);
+        std::vector<int64_t> tail = read_times(tail_path);
+        if (previous.size() < count || previous.size() < 2 || tail.empty()) {
+            return;  // No sidecars (or incomplete): the SDK falls back to nominal fps
+        }
+        
+        std::ofstream out(segment_timestamps_path(merged_path));
+        size_t first = previous.size() - count;
+        for (size_t i = first; i < previous.size(); ++i) {
+            out << (previous[i] - previous[first]) << '\n';
+        }
+        int64_t gap = previous.back() - previous[previous.size() - 2];
+        int64_t tail_start = previous.back() - previous[first] + gap;
+        for (int64_t time_us : tail) {
+            out << (tail_start + time_us) << '\n';
+        }
+    }
+    
+    void broadcastSegmentSkipped(const ProcessingJob& job, const std::string& reason) {
+        LOG(INFO) << "Skipping segment " << job.segment_index << " of session " << job.session_id
+                  << " (" << job.encode_stats.frames << " frames, " << reason << ")";
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = "segment_skipped";
+            status_msg["session_id"] = job.session_id;
+            status_msg["segment_index"] = job.segment_index;
+            status_msg["reason"] = reason;
+            status_msg["frames"] = job.encode_stats.frames;
+            status_msg["min_segment_frames"] = min_segment_frames_;
+            if (job.encode_stats.face_samples > 0) {
+                status_msg["face_coverage"] = job.encode_stats.faceCoverage();
+            }
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+    }
+    
+    /**
+     * Per-run state the SDK callbacks of one segment share, whether the SDK
+     * runs on a thread here or in a worker process.
+     */
+    struct SegmentRun {
+        std::string session_id;
+        size_t segment_index;
+        PipelineTimestamps timestamps;
+        ImagingStatusWatch status_watch;
+        size_t metrics_count = 0;
+        double pulse_confidence_sum = 0.0;
+        double breathing_confidence_sum = 0.0;
+        
+        // Result cache: callbacks are recorded while cache_key is set and
+        // stored if the run completes without error
+        uint64_t cache_key = 0;
+        std::vector<SdkResultCache::Record> cache_records;
+        bool cached = false;  // Replayed from the cache
+        bool run_ok = true;   // Run() returned OK or was cancelled
+        
+        SegmentRun(const std::string& session, size_t index, const PipelineTimestamps& stamps,
+                   double max_bad_seconds)
+            : session_id(session), segment_index(index), timestamps(stamps), status_watch(max_bad_seconds) {}
+    };
+    
+    void broadcastSegmentProcessing(const std::string& video_path, const std::string& session_id,
+                                    size_t segment_index, const PipelineTimestamps& timestamps) {
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = "segment_processing";
+            status_msg["session_id"] = session_id;
+            status_msg["segment_index"] = segment_index;
+            status_msg["video_path"] = video_path;
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            status_msg["latency"] = pipeline_latency_to_json(timestamps, PipelineTimestamps::Clock::now());
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+    }
+    
+    void onSegmentMetrics(SegmentRun& run, const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+        if (run.metrics_count == 0) {
+            run.timestamps.first_callback = PipelineTimestamps::Clock::now();
+        }
+        
+        // Convert SDK metrics to our JSON format and broadcast
+        std::string json_str = sdkMetricsToJson(metrics, timestamp, run.session_id);
+        
+        // Add segment info to the JSON
+        json j = json::parse(json_str);
+        j["segment_index"] = run.segment_index;
+        j["realtime"] = true;  // Flag to indicate this is real-time data
+        j["latency"] = pipeline_latency_to_json(run.timestamps, PipelineTimestamps::Clock::now());
+        run.pulse_confidence_sum += j.value("pulse_confidence", 0.0);
+        run.breathing_confidence_sum += j.value("breathing_confidence", 0.0);
+        
+        if (g_metrics_server) {
+            g_metrics_server->broadcast(j.dump());
+        }
+        
+        run.metrics_count++;
+        if (run.cache_key != 0) {
+            run.cache_records.push_back(SdkResultCache::metricsRecord(metrics, timestamp));
+        }
+    }
+    
+    /**
+     * @return true if the run should stop (imaging status unusable for too long)
+     */
+    bool onSegmentStatus(SegmentRun& run, int status_code, int64_t timestamp) {
+        broadcastImagingStatus(run.session_id, status_code, static_cast<int64_t>(run.segment_index));
+        if (run.cache_key != 0) {
+            run.cache_records.push_back(SdkResultCache::statusRecord(status_code, timestamp));
+        }
+        return run.status_watch.update(status_code, timestamp);
+    }
+    
+    /**
+     * Re-check the status watch at an output frame's media time.
+     *
+     * @return true if the run should stop
+     */
+    bool onSegmentFrame(SegmentRun& run, int64_t timestamp) {
+        bool was_aborted = run.status_watch.aborted();
+        if (!run.status_watch.tick(timestamp)) {
+            return false;
+        }
+        if (!was_aborted && run.cache_key != 0) {
+            // Lets a replay from the cache reach the same abort
+            run.cache_records.push_back(SdkResultCache::statusRecord(run.status_watch.lastCode(), timestamp));
+        }
+        return true;
+    }
+    
+    void onSegmentInitialized(SegmentRun& run, PipelineTimestamps::Clock::time_point init_started) {
+        run.timestamps.sdk_initialized = PipelineTimestamps::Clock::now();
+        g_stats.sdk_init_seconds.observe(stage_ms(run.timestamps.job_dequeued, run.timestamps.sdk_initialized) / 1000.0);
+        PipelineTracer::instance().record("sdk_initialize", init_started, run.timestamps.sdk_initialized,
+                                          static_cast<int64_t>(run.segment_index));
+    }
+    
+    void onSegmentRunCompleted(SegmentRun& run) {
+        run.timestamps.run_completed = PipelineTimestamps::Clock::now();
+        PipelineTracer::instance().record("sdk_run", run.timestamps.sdk_initialized, run.timestamps.run_completed,
+                                          static_cast<int64_t>(run.segment_index));
+        g_stats.job_run_seconds.observe(stage_ms(run.timestamps.sdk_initialized, run.timestamps.run_completed) / 1000.0);
+    }
+    
+    /**
+     * Log, benchmark and broadcast the outcome of a segment run that finished.
+     */
+    void reportSegmentCompleted(const SegmentRun& run, const SegmentEncodeStats& encode_stats) {
+        LOG(INFO) << "SDK segment " << run.segment_index << " completed"
+                  << " - " << run.metrics_count << " metrics generated";
+        
+        double mean_pulse_confidence = run.metrics_count > 0 ? run.pulse_confidence_sum / run.metrics_count : 0.0;
+        double mean_breathing_confidence = run.metrics_count > 0 ? run.breathing_confidence_sum / run.metrics_count : 0.0;
+        json encode;
+        encode["codec"] = recording_codec_name(encode_stats.codec);
+        encode["frames"] = encode_stats.frames;
+        encode["encode_cpu_ms"] = encode_stats.encode_cpu_ms;
+        encode["bytes"] = encode_stats.bytes;
+        encode["mean_pulse_confidence"] = mean_pulse_confidence;
+        encode["mean_breathing_confidence"] = mean_breathing_confidence;
+        if (encode_stats.quality_screened > 0) {
+            json quality;
+            quality["screened"] = encode_stats.quality_screened;
+            quality["dropped"] = encode_stats.quality_dropped;
+            quality["mean_sharpness"] = encode_stats.mean_sharpness;
+            quality["mean_brightness"] = encode_stats.mean_brightness;
+            quality["mean_motion"] = encode_stats.mean_motion;
+            encode["quality"] = quality;
+        }
+        if (g_codec_benchmark && !run.cached) {
+            g_codec_benchmark->record(encode_stats, run.metrics_count, mean_pulse_confidence,
+                                      mean_breathing_confidence);
+        }
+        // A failed run (e.g. a transient REST error) must not be replayed on retry
+        if (g_sdk_result_cache && run.cache_key != 0 && run.run_ok) {
+            g_sdk_result_cache->store(run.cache_key, run.cache_records);
+        }
+        
+        const ImagingStatusWatch& status_watch = run.status_watch;
+        if (status_watch.aborted() && !run.cached) {
+            g_stats.sdk_runs_aborted++;
+            LOG(INFO) << "SDK segment " << run.segment_index << " aborted: imaging status "
+                      << status_watch.lastCode() << " since " << status_watch.badSinceSeconds() << "s";
+        }
+        
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = status_watch.aborted() ? "segment_aborted" : "segment_completed";
+            status_msg["session_id"] = run.session_id;
+            status_msg["segment_index"] = run.segment_index;
+            status_msg["metrics_count"] = run.metrics_count;
+            status_msg["encode"] = encode;
+            if (run.cached) {
+                status_msg["cached"] = true;
+            }
+            if (status_watch.aborted()) {
+                addAbortFields(status_msg, status_watch);
+            }
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            status_msg["latency"] = pipeline_latency_to_json(run.timestamps, PipelineTimestamps::Clock::now());
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+    }
+    
+    /**
+     * Process a video segment and emit metrics.
+     * Optimized for quick turnaround on short segments.
+     * 
+     * @param cache_key Result cache key to store the output under (0 = don't)
+     * @param cancelled Set by the watchdog once the job is past its deadline
+     * @return true if the SDK ran to completion
+     */
+    bool processVideoSegment(const std::string& video_path, const std::string& session_id,
+                             size_t segment_index, const PipelineTimestamps& timestamps,
+                             const SegmentEncodeStats& encode_stats, uint64_t cache_key = 0,
+                             const std::atomic<bool>* cancelled = nullptr) {
+        LOG(INFO) << "SDK segment processing started for: " << video_path;
+        
+        // Broadcast processing start status
+        broadcastSegmentProcessing(video_path, session_id, segment_index, timestamps);
+        
+        try {
+            // Create SDK container
+            auto container = std::make_unique<container::CpuContinuousRestForegroundContainer>(
+                make_segment_sdk_settings(video_path, api_key_, frame_width_, frame_height_));
+            
+            // Track metrics count and confidence for this segment
+            SegmentRun run(session_id, segment_index, timestamps, bad_status_abort_seconds_);
+            run.cache_key = cache_key;
+            
+            // Register metrics callback
+            auto metrics_status = container->SetOnCoreMetricsOutput(
+                [this, &run, cancelled](const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+                    if (cancelled && *cancelled) {
+                        return absl::CancelledError("job deadline passed");
+                    }
+                    onSegmentMetrics(run, metrics, timestamp);
+                    return absl::OkStatus();
+                }
+            );
+            
+            if (!metrics_status.ok()) {
+                LOG(ERROR) << "Failed to set SDK metrics callback: " << metrics_status.message();
+                return false;
+            }
+            
+            // Returning Cancelled from the status callback stops Run() early
+            auto status_callback_status = container->SetOnStatusChange(
+                [this, &run, cancelled](presage::physiology::StatusValue imaging_status) {
+                    if (cancelled && *cancelled) {
+                        return absl::CancelledError("job deadline passed");
+                    }
+                    if (onSegmentStatus(run, static_cast<int>(imaging_status.value()), imaging_status.timestamp())) {
+                        return absl::CancelledError("imaging status unusable");
+                    }
+                    return absl::OkStatus();
+                }
+            );
+            if (!status_callback_status.ok()) {
+                LOG(WARNING) << "Failed to set SDK status callback: " << status_callback_status.message();
+            }
+            
+            // Status callbacks only come on changes, so each output frame
+            // also runs the watch forward
+            auto video_output_status = container->SetOnVideoOutput(
+                [this, &run, cancelled](cv::Mat&, int64_t timestamp) {
+                    if (cancelled && *cancelled) {
+                        return absl::CancelledError("job deadline passed");
+                    }
+                    if (onSegmentFrame(run, timestamp)) {
+                        return absl::CancelledError("imaging status unusable");
+                    }
+                    return absl::OkStatus();
+                }
+            );
+            if (!video_output_status.ok()) {
+                LOG(WARNING) << "Failed to set SDK video output callback: " << video_output_status.message();
+            }
+            
+            // Initialize and run SDK (blocking until video ends)
+            auto init_started = PipelineTimestamps::Clock::now();
+            if (auto init_status = container->Initialize(); !init_status.ok()) {
+                LOG(ERROR) << "Failed to initialize SDK for segment: " << init_status.message();
+                return false;
+            }
+            onSegmentInitialized(run, init_started);
+            
+            if (auto run_status = container->Run(); !run_status.ok()) {
+                if (!absl::IsCancelled(run_status)) {
+                    LOG(ERROR) << "SDK segment processing error: " << run_status.message();
+                    run.run_ok = false;
+                }
+            }
+            
+            // Past the deadline the runner may have been abandoned and the
+            // processor torn down, so touch nothing of it from here on
+            if (cancelled && *cancelled) {
+                LOG(WARNING) << "SDK segment " << segment_index << " cancelled after its deadline";
+                return false;  // The watchdog reports it
+            }
+            onSegmentRunCompleted(run);
+            
+            reportSegmentCompleted(run, encode_stats);
+            return run.run_ok;  // A failed run stays journaled for a retry
+        } catch (const std::exception& e) {
+            LOG(ERROR) << "SDK segment processing exception: " << e.what();
+            return false;
+        }
+    }
+    void processVideo(const std::string& video_path, const std::string& session_id) {
+        LOG(INFO) << "SDK processing started for: " << video_path;
+        
+        PipelineTimestamps timestamps;
+        timestamps.job_dequeued = PipelineTimestamps::Clock::now();
+        
+        // Broadcast processing start status
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_status";
+            status_msg["status"] = "processing_started";
+            status_msg["session_id"] = session_id;
+            status_msg["video_path"] = video_path;
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+        
+        // A recording the SDK has already processed replays from the result cache
+        uint64_t cache_key = 0;
+        std::vector<SdkResultCache::Record> cached_records;
+        bool cache_hit = false;
+        if (g_sdk_result_cache) {
+            cache_key = g_sdk_result_cache->keyFor(video_path, sdkCacheFingerprint(false));
+            cache_hit = cache_key != 0 && g_sdk_result_cache->load(cache_key, &cached_records);
+        }
+        std::vector<SdkResultCache::Record> new_records;
+        bool record = cache_key != 0 && !cache_hit;
+        
+        try {
+            // Track metrics count for this session
+            size_t metrics_count = 0;
+            
+            auto on_metrics = [this, session_id, &metrics_count, &timestamps, record, &new_records](
+                    const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+                if (metrics_count == 0) {
+                    timestamps.first_callback = PipelineTimestamps::Clock::now();
+                }
+                
+                // Convert SDK metrics to our JSON format and broadcast
+                json j = json::parse(sdkMetricsToJson(metrics, timestamp, session_id));
+                j["latency"] = pipeline_latency_to_json(timestamps, PipelineTimestamps::Clock::now());
+                
+                if (g_metrics_server) {
+                    g_metrics_server->broadcast(j.dump());
+                }
+                
+                metrics_count++;
+                if (record) {
+                    new_records.push_back(SdkResultCache::metricsRecord(metrics, timestamp));
+                }
+                
+                // Log periodically
+                if (metrics_count % 10 == 0) {
+                    LOG(INFO) << "SDK metrics broadcast #" << metrics_count 
+                              << " for session " << session_id;
+                }
+            };
+            
+            // Returns true once the status has been unusable for too long
+            ImagingStatusWatch status_watch(bad_status_abort_seconds_);
+            auto on_status = [this, session_id, &status_watch, record, &new_records](int status_code, int64_t timestamp) {
+                broadcastImagingStatus(session_id, status_code, -1);
+                if (record) {
+                    new_records.push_back(SdkResultCache::statusRecord(status_code, timestamp));
+                }
+                return status_watch.update(status_code, timestamp);
+            };
+            
+            bool run_ok = true;
+            if (cache_hit) {
+                LOG(INFO) << "SDK result cache hit for " << video_path << " (" << cached_records.size()
+                          << " callbacks)";
+                timestamps.sdk_initialized = PipelineTimestamps::Clock::now();
+                SdkResultCache::replay(cached_records, on_metrics, on_status);
+            } else {
+                // Create SDK settings
+                container::settings::Settings<
+                    container::settings::OperationMode::Continuous,
+                    container::settings::IntegrationMode::Rest
+                > settings;
+                
+                // Configure video source for file input
+                settings.video_source.input_video_path = video_path;
+                settings.video_source.device_index = -1;  // Disable camera, use file
+                settings.video_source.capture_width_px = frame_width_;
+                settings.video_source.capture_height_px = frame_height_;
+                settings.video_source.codec = presage::camera::CaptureCodec::MJPG;
+                settings.video_source.auto_lock = true;
+                
+                // SDK configuration
+                settings.headless = true;  // No GUI
+                settings.enable_edge_metrics = true;
+                settings.verbosity_level = 1;
+                settings.continuous.preprocessed_data_buffer_duration_s = 0.5;
+                settings.integration.api_key = api_key_;
+                
+                // Create SDK container
+                auto container = std::make_unique<container::CpuContinuousRestForegroundContainer>(settings);
+                
+                // Register metrics callback
+                auto metrics_status = container->SetOnCoreMetricsOutput(
+                    [&on_metrics](const presage::physiology::MetricsBuffer& metrics, int64_t timestamp) {
+                        on_metrics(metrics, timestamp);
+                        return absl::OkStatus();
+                    }
+                );
+                
+                if (!metrics_status.ok()) {
+                    LOG(ERROR) << "Failed to set SDK metrics callback: " << metrics_status.message();
+                    broadcastError(session_id, "Failed to set metrics callback");
+                    processing_ = false;
+                    return;
+                }
+                
+                // Register status callback; returning Cancelled stops Run() early
+                container->SetOnStatusChange(
+                    [&on_status](presage::physiology::StatusValue imaging_status) {
+                        if (on_status(static_cast<int>(imaging_status.value()), imaging_status.timestamp())) {
+                            return absl::CancelledError("imaging status unusable");
+                        }
+                        return absl::OkStatus();
+                    }
+                );
+                
+                // Status callbacks only come on changes; each output frame
+                // runs the watch forward. The frame that runs it out is
+                // recorded as a status so a cache replay aborts the same way.
+                container->SetOnVideoOutput(
+                    [&status_watch, record, &new_records](cv::Mat&, int64_t timestamp) {
+                        if (status_watch.aborted() || !status_watch.tick(timestamp)) {
+                            return absl::OkStatus();
+                        }
+                        if (record) {
+                            new_records.push_back(SdkResultCache::statusRecord(status_watch.lastCode(), timestamp));
+                        }
+                        return absl::CancelledError("imaging status unusable");
+                    }
+                );
+                
+                // Initialize SDK
+                LOG(INFO) << "Initializing SDK for video: " << video_path;
+                if (auto init_status = container->Initialize(); !init_status.ok()) {
+                    LOG(ERROR) << "Failed to initialize SDK: " << init_status.message();
+                    broadcastError(session_id, "SDK initialization failed: " + std::string(init_status.message()));
+                    processing_ = false;
+                    return;
+                }
+                timestamps.sdk_initialized = PipelineTimestamps::Clock::now();
+                
+                LOG(INFO) << "SDK initialized, starting video processing...";
+                
+                // Run processing (blocks until video ends)
+                if (auto run_status = container->Run(); !run_status.ok()) {
+                    // CancelledError is normal when video ends
+                    if (!absl::IsCancelled(run_status)) {
+                        LOG(ERROR) << "SDK processing error: " << run_status.message();
+                        broadcastError(session_id, "SDK processing error: " + std::string(run_status.message()));
+                        run_ok = false;
+                    }
+                }
+            }
+            timestamps.run_completed = PipelineTimestamps::Clock::now();
+            
+            LOG(INFO) << "SDK processing completed for session " << session_id 
+                      << " - " << metrics_count << " metrics generated";
+            if (status_watch.aborted() && !cache_hit) {
+                g_stats.sdk_runs_aborted++;
+                LOG(INFO) << "SDK processing for session " << session_id << " aborted: imaging status "
+                          << status_watch.lastCode() << " since " << status_watch.badSinceSeconds() << "s";
+            }
+            if (record && run_ok) {
+                g_sdk_result_cache->store(cache_key, new_records);
+            }
+            
+            // Broadcast completion status
+            if (g_metrics_server) {
+                json status_msg;
+                status_msg["type"] = "sdk_status";
+                status_msg["status"] = status_watch.aborted() ? "processing_aborted" : "processing_completed";
+                status_msg["session_id"] = session_id;
+                status_msg["metrics_count"] = metrics_count;
+                if (status_watch.aborted()) {
+                    addAbortFields(status_msg, status_watch);
+                }
+                if (cache_hit) {
+                    status_msg["cached"] = true;
+                }
+                status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                status_msg["latency"] = pipeline_latency_to_json(timestamps, PipelineTimestamps::Clock::now());
+                g_metrics_server->broadcast(status_msg.dump());
+            }
+            
+        } catch (const std::exception& e) {
+            LOG(ERROR) << "SDK processing exception: " << e.what();
+            broadcastError(session_id, std::string("SDK exception: ") + e.what());
+        }
+        
+        processing_ = false;
+        current_session_id_.clear();
+    }
+    
+    /**
+     * Convert SDK MetricsBuffer to our extended JSON format.
+     */
+    std::string sdkMetricsToJson(const presage::physiology::MetricsBuffer& metrics, 
+                                  int64_t timestamp, const std::string& session_id) {
+        json j;
+        j["type"] = "metrics";
+        j["source"] = "presage_sdk";
+        j["session_id"] = session_id;
+        j["timestamp"] = timestamp;
+        
+        // =====================================================================
+        // PULSE METRICS
+        // =====================================================================
+        
+        // Extract pulse rate from the most recent rate measurement
+        float pulse_rate = 0.0f;
+        float pulse_confidence = 0.0f;
+        if (metrics.pulse().rate_size() > 0) {
+            // Get the last (most recent) rate measurement
+            const auto& last_rate = metrics.pulse().rate(metrics.pulse().rate_size() - 1);
+            pulse_rate = last_rate.value();
+            pulse_confidence = last_rate.confidence();
+        } else if (metrics.has_pulse() && metrics.pulse().has_strict()) {
+            // Fallback to strict value if rate array is empty
+            pulse_rate = metrics.pulse().strict().value();
+        }
+        j["pulse_rate"] = pulse_rate;
+        j["pulse_confidence"] = pulse_confidence;
+        
+        // Extract full pulse trace for HRV calculation (PPG signal)
+        // Format: [[time1, value1], [time2, value2], ...]
+        json trace_array = json::array();
+        for (int i = 0; i < metrics.pulse().trace_size(); ++i) {
+            const auto& trace_point = metrics.pulse().trace(i);
+            trace_array.push_back({trace_point.time(), trace_point.value()});
+        }
+        j["pulse_trace"] = trace_array;
+        
+        // =====================================================================
+        // BREATHING METRICS
+        // =====================================================================
+        
+        // Extract breathing rate from the most recent rate measurement
+        float breathing_rate = 0.0f;
+        float breathing_confidence = 0.0f;
+        if (metrics.breathing().rate_size() > 0) {
+            // Get the last (most recent) rate measurement
+            const auto& last_rate = metrics.breathing().rate(metrics.breathing().rate_size() - 1);
+            breathing_rate = last_rate.value();
+            breathing_confidence = last_rate.confidence();
         } else if (metrics.has_breathing() && metrics.breathing().has_strict()) {
             // Fallback to strict value if rate array is empty
             breathing_rate = metrics.breathing().strict().value();
         }
-        j["breathing_rate"] = breathing_rate;
-        j["breathing_confidence"] = breathing_confidence;
+        j["breathing_rate"] = breathing_rate;
+        j["breathing_confidence"] = breathing_confidence;
+        
+        // Extract breathing amplitude (depth of breathing over time)
+        // Format: [[time1, value1], [time2, value2], ...]
+        json amplitude_array = json::array();
+        for (int i = 0; i < metrics.breathing().amplitude_size(); ++i) {
+            const auto& amp_point = metrics.breathing().amplitude(i);
+            amplitude_array.push_back({amp_point.time(), amp_point.value()});
+        }
+        j["breathing_amplitude"] = amplitude_array;
+        
+        // Extract upper breathing trace (chest movement signal)
+        json upper_trace_array = json::array();
+        for (int i = 0; i < metrics.breathing().upper_trace_size(); ++i) {
+            const auto& trace_point = metrics.breathing().upper_trace(i);
+            upper_trace_array.push_back({trace_point.time(), trace_point.value()});
+        }
+        j["breathing_upper_trace"] = upper_trace_array;
+        
+        // =====================================================================
+        // APNEA DETECTION
+        // =====================================================================
+        
+        // Check if apnea was detected in the most recent apnea event
+        bool apnea_detected = false;
+        if (metrics.breathing().apnea_size() > 0) {
+            // Get the most recent apnea event
+            const auto& last_apnea = metrics.breathing().apnea(metrics.breathing().apnea_size() - 1);
+            apnea_detected = last_apnea.detected();
+        }
+        j["apnea_detected"] = apnea_detected;
+        
+        // =====================================================================
+        // FACE METRICS
+        // =====================================================================
+        
+        // Check if blinking was detected in the most recent blinking event
+        bool blinking = false;
+        if (metrics.face().blinking_size() > 0) {
+            // Get the most recent blink event
+            const auto& last_blink = metrics.face().blinking(metrics.face().blinking_size() - 1);
+            blinking = last_blink.detected();
+        }
+        j["blinking"] = blinking;
+        
+        // Check if talking was detected in the most recent talking event
+        bool talking = false;
+        if (metrics.face().talking_size() > 0) {
+            // Get the most recent talking event
+            const auto& last_talk = metrics.face().talking(metrics.face().talking_size() - 1);
+            talking = last_talk.detected();
+        }
+        j["talking"] = talking;
+        
+        // =====================================================================
+        // ADDITIONAL METADATA
+        // =====================================================================
+        
+        // Include measurement metadata if available
+        if (metrics.has_metadata()) {
+            j["measurement_id"] = metrics.metadata().id();
+            j["upload_timestamp"] = metrics.metadata().upload_timestamp();
+        }
+        
+        // =====================================================================
+        // BLOOD PRESSURE (if enabled and available)
+        // =====================================================================
+        
+        // Note: Blood pressure requires enable_phasic_bp = true in settings
+        if (metrics.has_blood_pressure() && metrics.blood_pressure().phasic_size() > 0) {
+            const auto& last_bp = metrics.blood_pressure().phasic(metrics.blood_pressure().phasic_size() - 1);
+            j["phasic_blood_pressure"] = last_bp.value();
+        }
+        
+        return j.dump();
+    }
+    
+    /**
+     * Forward an SDK imaging status change to metrics clients.
+     * 
+     * @param segment_index Segment being processed, or -1 for a whole recording
+     */
+    void broadcastImagingStatus(const std::string& session_id, int status_code, int64_t segment_index) {
+        std::string status_desc = presage::physiology::GetStatusDescription(
+            static_cast<presage::physiology::StatusCode>(status_code));
+        LOG(INFO) << "SDK Status [" << session_id << "]: " << status_desc;
+        
+        if (g_metrics_server) {
+            json status_msg;
+            status_msg["type"] = "sdk_imaging_status";
+            status_msg["session_id"] = session_id;
+            if (segment_index >= 0) {
+                status_msg["segment_index"] = segment_index;
+            }
+            status_msg["status"] = status_desc;
+            status_msg["status_code"] = status_code;
+            status_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(status_msg.dump());
+        }
+    }
+    
+    /**
+     * Describe an early stop: everything from skipped_from_seconds on was
+     * not processed.
+     */
+    static void addAbortFields(json& status_msg, const ImagingStatusWatch& status_watch) {
+        auto code = static_cast<presage::physiology::StatusCode>(status_watch.lastCode());
+        status_msg["reason"] = presage::physiology::GetStatusDescription(code);
+        status_msg["status_code"] = status_watch.lastCode();
+        status_msg["skipped_from_seconds"] = status_watch.badSinceSeconds();
+    }
+    
+    void broadcastError(const std::string& session_id, const std::string& error) {
+        if (g_metrics_server) {
+            json error_msg;
+            error_msg["type"] = "sdk_status";
+            error_msg["status"] = "error";
+            error_msg["session_id"] = session_id;
+            error_msg["error"] = error;
+            error_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(error_msg.dump());
+        }
+    }
+    
+    /**
+     * Report a segment job that failed outright (deadline, dead worker).
+     * 
+     * @param reason Machine-readable cause
+     * @param details Extra fields to include
+     */
+    void broadcastJobError(const ProcessingJob& job, const std::string& error, const std::string& reason,
+                           const json& details = json::object()) {
+        if (g_metrics_server) {
+            json error_msg;
+            error_msg["type"] = "sdk_status";
+            error_msg["status"] = "error";
+            error_msg["session_id"] = job.session_id;
+            error_msg["segment_index"] = job.segment_index;
+            error_msg["error"] = error;
+            error_msg["reason"] = reason;
+            error_msg.update(details);
+            error_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            g_metrics_server->broadcast(error_msg.dump());
+        }
+    }
+    
+    std::string api_key_;
+    int frame_width_;
+    int frame_height_;
+    
+    size_t worker_processes_;
+    size_t worker_memory_limit_mb_;
+    
+    std::atomic<bool> processing_;
+    std::atomic<bool> shutdown_;
+    std::string current_session_id_;
+    std::thread processing_thread_;
+    
+    // Short-segment handling (worker thread only after setup)
+    TailPolicy tail_policy_ = TailPolicy::kProcess;
+    double face_gate_coverage_ = 0.0;
+    double bad_status_abort_seconds_ = 0.0;
+    
+    // Watchdog (worker thread only after setup)
+    static constexpr double kUnknownMediaSeconds = 10.0;
+    static constexpr int kCancelGraceSeconds = 5;
+    static constexpr int kAbandonedJoinSeconds = 10;  // Total wait for abandoned runners at shutdown
+    double job_deadline_factor_ = 0.0;
+    int job_deadline_min_seconds_ = 30;
+    size_t min_segment_frames_ = 0;
+    
+    // Runner threads left on a stuck SDK call, joined at shutdown
+    std::mutex abandoned_mutex_;
+    std::vector<std::shared_ptr<Runner>> abandoned_runners_;
+    
+    // Segments waiting for a lane, in queueing order, and the latest
+    // processed full segment held for a tail merge (both guarded by queue_mutex_)
+    std::deque<ProcessingJob> queue_;
+    std::optional<ProcessingJob> merge_source_;
+    
+    // One lane per worker
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+};
+
+// ============================================================================
+// Shared-Memory Frame Ring - Zero-copy frame transport for co-located backends
+// ============================================================================
+
+/**
+ * Single-producer/single-consumer ring of frame slots in a POSIX shm segment.
+ * 
+ * The daemon creates and owns the segment; the backend maps it by name after
+ * negotiating over the control channel, writes JPEG bytes straight into a slot
+ * and bumps write_seq. The daemon decodes the slot in place and bumps read_seq.
+ * Both sequence words double as futex words so either side can sleep on them.
+ * 
+ * Layout (little-endian):
+ *   [0, 64)    RingHeader
+ *   [64, ...)  slot_count x (16-byte SlotHeader + slot_size payload bytes)
+ */
+class ShmFrameRing {
+public:
+    static constexpr uint32_t kMagic = 0x4d485350;  // "PSHM"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kHeaderBytes = 64;
+    static constexpr size_t kSlotHeaderBytes = 16;
+    static constexpr uint32_t kMaxSlots = 64;
+    static constexpr uint32_t kMaxSlotSize = 10 * 1024 * 1024;
+    
+    struct RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t slot_size;
+        std::atomic<uint32_t> write_seq;  // Slots published by the producer
+        std::atomic<uint32_t> read_seq;   // Slots released by the consumer
+        uint32_t reserved[10];
+    };
+    
+    struct SlotHeader {
+        uint32_t length;        // Payload bytes in this slot
+        uint32_t flags;         // Reserved, must be 0
+        uint64_t timestamp_us;  // Producer capture time (0 if unknown)
+    };
+    
+    static_assert(sizeof(RingHeader) == kHeaderBytes, "RingHeader layout is part of the protocol");
+    static_assert(sizeof(SlotHeader) == kSlotHeaderBytes, "SlotHeader layout is part of the protocol");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Ring sequence words must be lock-free");
+    
+    /**
+     * Create and map a new ring. Returns nullptr on failure.
+     */
+    static std::unique_ptr<ShmFrameRing> create(const std::string& name, uint32_t slot_count,
+                                                uint32_t slot_size) {
+        if (slot_count == 0 || slot_count > kMaxSlots || slot_size == 0 || slot_size > kMaxSlotSize) {
+            LOG(WARNING) << "Invalid shm ring geometry: " << slot_count << " x " << slot_size;
+            return nullptr;
+        }
         
-        // Extract breathing amplitude (depth of breathing over time)
-        // Format: [[time1, value1], [time2, value2], ...]
-        json amplitude_array = json::array();
-        for (int i = 0; i < metrics.breathing().amplitude_size(); ++i) {
-            const auto& amp_point = metrics.breathing().amplitude(i);
-            amplitude_array.push_back({amp_point.time(), amp_point.value()});
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            LOG(ERROR) << "shm_open failed for " << name << ": " << strerror(errno);
+            return nullptr;
         }
-        j["breathing_amplitude"] = amplitude_array;
         
-        // Extract upper breathing trace (chest movement signal)
-        json upper_trace_array = json::array();
-        for (int i = 0; i < metrics.breathing().upper_trace_size(); ++i) {
-            const auto& trace_point = metrics.breathing().upper_trace(i);
-            upper_trace_array.push_back({trace_point.time(), trace_point.value()});
+        size_t bytes = kHeaderBytes + static_cast<size_t>(slot_count) * (kSlotHeaderBytes + slot_size);
+        if (ftruncate(fd, bytes) < 0) {
+            LOG(ERROR) << "ftruncate failed for " << name << ": " << strerror(errno);
+            close(fd);
+            shm_unlink(name.c_str());
+            return nullptr;
         }
-        j["breathing_upper_trace"] = upper_trace_array;
         
-        // =====================================================================
-        // APNEA DETECTION
-        // =====================================================================
+        void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            LOG(ERROR) << "mmap failed for " << name << ": " << strerror(errno);
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+        
+        auto* header = new (base) RingHeader{};
+        header->magic = kMagic;
+        header->version = kVersion;
+        header->slot_count = slot_count;
+        header->slot_size = slot_size;
+        header->write_seq.store(0, std::memory_order_relaxed);
+        header->read_seq.store(0, std::memory_order_release);
+        
+        return std::unique_ptr<ShmFrameRing>(new ShmFrameRing(name, base, bytes, slot_count, slot_size));
+    }
+    
+    ~ShmFrameRing() {
+        munmap(base_, bytes_);
+        shm_unlink(name_.c_str());
+    }
+    
+    const std::string& name() const { return name_; }
+    // Geometry as created; the mapped header is client-writable, so it is never read back
+    uint32_t slotCount() const { return slot_count_; }
+    uint32_t slotSize() const { return slot_size_; }
+    
+    /**
+     * Wait for the next published slot and take it.
+     * Several slots may be taken before any is released, so frames can be
+     * decoded in parallel straight out of the ring.
+     * 
+     * @param timeout_ms Max time to sleep when the ring is empty
+     * @param payload Receives a pointer to the slot's bytes (valid until it is released)
+     * @return Slot header, or nullptr if nothing arrived in time
+     */
+    const SlotHeader* waitForSlot(int timeout_ms, const uint8_t** payload) {
+        RingHeader* h = header();
+        uint32_t write = h->write_seq.load(std::memory_order_acquire);
+        if (write == next_read_) {
+            futexWait(&h->write_seq, write, timeout_ms);
+            write = h->write_seq.load(std::memory_order_acquire);
+            if (write == next_read_) {
+                return nullptr;
+            }
+        }
+        
+        uint8_t* slot = slotAt(next_read_ % slot_count_);
+        next_read_++;
+        auto* slot_header = reinterpret_cast<const SlotHeader*>(slot);
+        *payload = slot + kSlotHeaderBytes;
+        return slot_header;
+    }
+    
+    /**
+     * Hand the oldest taken slot back to the producer (slots release in order).
+     */
+    void releaseSlot() {
+        RingHeader* h = header();
+        h->read_seq.fetch_add(1, std::memory_order_release);
+        futexWake(&h->read_seq);
+    }
+    
+    /**
+     * Wait until every published slot has been consumed.
+     * Used before session_end so no in-flight frames are dropped.
+     */
+    bool waitDrained(int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        RingHeader* h = header();
+        while (true) {
+            uint32_t read = h->read_seq.load(std::memory_order_acquire);
+            if (read == h->write_seq.load(std::memory_order_acquire)) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            futexWait(&h->read_seq, read, 10);
+        }
+    }
+    
+private:
+    ShmFrameRing(const std::string& name, void* base, size_t bytes, uint32_t slot_count, uint32_t slot_size)
+        : name_(name), base_(base), bytes_(bytes), slot_count_(slot_count), slot_size_(slot_size) {}
+    
+    RingHeader* header() const {
+        return static_cast<RingHeader*>(base_);
+    }
+    
+    uint8_t* slotAt(uint32_t index) const {
+        return static_cast<uint8_t*>(base_) + kHeaderBytes +
+               static_cast<size_t>(index) * (kSlotHeaderBytes + slot_size_);
+    }
+    
+    // Shared (non-private) futex ops: the other side lives in another process
+    static void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms) {
+        struct timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    }
+    
+    static void futexWake(std::atomic<uint32_t>* word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+    
+    std::string name_;
+    void* base_;
+    size_t bytes_;
+    uint32_t slot_count_;
+    uint32_t slot_size_;
+    uint32_t next_read_ = 0;  // Consumer cursor: slots taken but maybe not yet released
+};
+
+// ============================================================================
+// JPEG Helpers
+// ============================================================================
+
+/**
+ * Read a baseline/progressive JPEG's dimensions from its SOF marker without
+ * decoding anything.
+ * 
+ * @return false if the data is not a JPEG or no SOF marker was found
+ */
+bool jpeg_dimensions(const uint8_t* data, size_t length, int* width, int* height) {
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    
+    size_t pos = 2;
+    while (pos + 4 <= length) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;  // Fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;  // Standalone markers carry no length
+            continue;
+        }
+        
+        size_t segment_length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        bool is_sof = marker >= 0xC0 && marker <= 0xCF &&
+                      marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_sof) {
+            if (pos + 9 > length) {
+                return false;
+            }
+            *height = (data[pos + 5] << 8) | data[pos + 6];
+            *width = (data[pos + 7] << 8) | data[pos + 8];
+            return *width > 0 && *height > 0;
+        }
+        if (marker == 0xDA || segment_length < 2) {
+            return false;  // Reached scan data without a frame header
+        }
+        pos += 2 + segment_length;
+    }
+    return false;
+}
+
+/**
+ * Pick the cheapest imdecode mode whose output still covers `target`.
+ * libjpeg scales in the DCT domain, so a 1/2 decode costs roughly a quarter
+ * of a full one; the remaining resize then works on far fewer pixels.
+ */
+int reduced_decode_flag(int width, int height, cv::Size target) {
+    static const std::pair<int, int> kScales[] = {
+        {8, cv::IMREAD_REDUCED_COLOR_8},
+        {4, cv::IMREAD_REDUCED_COLOR_4},
+        {2, cv::IMREAD_REDUCED_COLOR_2},
+    };
+    if (target.empty()) {
+        return cv::IMREAD_COLOR;
+    }
+    for (const auto& [scale, flag] : kScales) {
+        // libjpeg rounds scaled dimensions up
+        int scaled_width = (width + scale - 1) / scale;
+        int scaled_height = (height + scale - 1) / scale;
+        if (scaled_width >= target.width && scaled_height >= target.height) {
+            return flag;
+        }
+    }
+    return cv::IMREAD_COLOR;
+}
+
+// ============================================================================
+// Raw Frame Payloads
+// ============================================================================
+
+enum class RawPixelFormat : uint8_t {
+    kNV12 = 1,
+    kI420 = 2,
+};
+
+/**
+ * Header prefixed to uncompressed frames on the video channel (big-endian,
+ * like the length prefix). Planes follow immediately, luma first.
+ * 
+ *   0  magic "PRAW"     4  version (1)   5  format   6  reserved (2)
+ *   8  width            12 height        16 stride   20 timestamp_us (8)
+ */
+struct RawFrameHeader {
+    uint8_t version = 0;
+    RawPixelFormat format = RawPixelFormat::kNV12;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;  // Luma row pitch in bytes; chroma pitch follows the format
+    uint64_t timestamp_us = 0;
+};
+
+constexpr size_t kRawFrameHeaderBytes = 28;
+constexpr size_t kTimestampPrefixBytes = 12;  // "PTS1" + uint64 capture time, before a JPEG
+constexpr uint32_t kRawFrameMaxDimension = 8192;
+
+/**
+ * Parse and validate a raw frame header, including that the payload holds
+ * every plane it describes.
+ * 
+ * @return false if the payload is not a well-formed raw frame
+ */
+bool parse_raw_frame_header(const uint8_t* data, size_t length, RawFrameHeader* header) {
+    if (length < kRawFrameHeaderBytes || std::memcmp(data, "PRAW", 4) != 0) {
+        return false;
+    }
+    auto be32 = [data](size_t offset) {
+        return (static_cast<uint32_t>(data[offset]) << 24) | (static_cast<uint32_t>(data[offset + 1]) << 16) |
+               (static_cast<uint32_t>(data[offset + 2]) << 8) | data[offset + 3];
+    };
+    
+    header->version = data[4];
+    header->format = static_cast<RawPixelFormat>(data[5]);
+    header->width = be32(8);
+    header->height = be32(12);
+    header->stride = be32(16);
+    header->timestamp_us = (static_cast<uint64_t>(be32(20)) << 32) | be32(24);
+    
+    if (header->version != 1) {
+        LOG(WARNING) << "Unsupported raw frame version " << static_cast<int>(header->version);
+        return false;
+    }
+    if (header->format != RawPixelFormat::kNV12 && header->format != RawPixelFormat::kI420) {
+        LOG(WARNING) << "Unsupported raw pixel format " << static_cast<int>(data[5]);
+        return false;
+    }
+    if (header->width == 0 || header->height == 0 || header->width % 2 || header->height % 2 ||
+        header->width > kRawFrameMaxDimension || header->height > kRawFrameMaxDimension ||
+        header->stride < header->width || header->stride % 2) {
+        LOG(WARNING) << "Invalid raw frame geometry " << header->width << "x" << header->height
+                     << " stride " << header->stride;
+        return false;
+    }
+    
+    // NV12: luma + half-height interleaved UV at the same stride.
+    // I420: luma + two quarter planes at half the stride. Both total 1.5 x stride x height.
+    size_t planes_bytes = static_cast<size_t>(header->stride) * header->height * 3 / 2;
+    if (length - kRawFrameHeaderBytes < planes_bytes) {
+        LOG(WARNING) << "Raw frame truncated: " << (length - kRawFrameHeaderBytes)
+                     << " bytes for " << planes_bytes << " bytes of planes";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// H.264 Stream Decoder - Per-session Annex-B decoding (libavcodec)
+// ============================================================================
+
+#ifdef PRESAGE_HAVE_LIBAVCODEC
+
+/**
+ * Long-lived H.264 decoder for one session's Annex-B elementary stream.
+ * 
+ * Chunks may split or join access units arbitrarily; the parser reassembles
+ * packets and the decoder keeps reference frames across calls. Decoding is
+ * inherently sequential, so it runs on the ingest thread rather than the
+ * transcode pool. Slice threading only, to avoid frame-threading delay.
+ */
+class H264StreamDecoder {
+public:
+    using FrameCallback = std::function<void(const cv::Mat&)>;
+    
+    static std::unique_ptr<H264StreamDecoder> create() {
+        const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+        if (!codec) {
+            LOG(ERROR) << "libavcodec has no H.264 decoder";
+            return nullptr;
+        }
+        
+        std::unique_ptr<H264StreamDecoder> decoder(new H264StreamDecoder());
+        decoder->parser_ = av_parser_init(codec->id);
+        decoder->context_ = avcodec_alloc_context3(codec);
+        decoder->packet_ = av_packet_alloc();
+        decoder->frame_ = av_frame_alloc();
+        if (!decoder->parser_ || !decoder->context_ || !decoder->packet_ || !decoder->frame_) {
+            LOG(ERROR) << "Failed to allocate H.264 decoder state";
+            return nullptr;
+        }
+        
+        decoder->context_->thread_count = 2;
+        decoder->context_->thread_type = FF_THREAD_SLICE;
+        decoder->context_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        if (avcodec_open2(decoder->context_, codec, nullptr) < 0) {
+            LOG(ERROR) << "Failed to open H.264 decoder";
+            return nullptr;
+        }
+        return decoder;
+    }
+    
+    ~H264StreamDecoder() {
+        if (parser_) av_parser_close(parser_);
+        if (context_) avcodec_free_context(&context_);
+        if (packet_) av_packet_free(&packet_);
+        if (frame_) av_frame_free(&frame_);
+    }
+    
+    H264StreamDecoder(const H264StreamDecoder&) = delete;
+    H264StreamDecoder& operator=(const H264StreamDecoder&) = delete;
+    
+    /**
+     * Feed one chunk of the elementary stream.
+     * 
+     * @param on_frame Called with each picture completed by this chunk (BGR)
+     * @return false if the decoder rejected the stream
+     */
+    bool decode(const uint8_t* data, size_t length, const FrameCallback& on_frame) {
+        // The parser may read past the end of its input: give it a zeroed tail
+        input_.resize(length + AV_INPUT_BUFFER_PADDING_SIZE);
+        std::memcpy(input_.data(), data, length);
+        std::memset(input_.data() + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        data = input_.data();
+        
+        while (length > 0) {
+            int consumed = av_parser_parse2(parser_, context_, &packet_->data, &packet_->size,
+                                            data, static_cast<int>(length),
+                                            AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+            if (consumed < 0) {
+                LOG(WARNING) << "H.264 parser error";
+                return false;
+            }
+            data += consumed;
+            length -= consumed;
+            
+            if (packet_->size > 0 && !sendPacket(packet_, on_frame)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    /**
+     * Emit pictures still buffered in the parser and decoder (end of session).
+     */
+    void flush(const FrameCallback& on_frame) {
+        av_parser_parse2(parser_, context_, &packet_->data, &packet_->size,
+                         nullptr, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        if (packet_->size > 0) {
+            sendPacket(packet_, on_frame);
+        }
+        sendPacket(nullptr, on_frame);
+    }
+    
+private:
+    H264StreamDecoder() = default;
+    
+    bool sendPacket(AVPacket* packet, const FrameCallback& on_frame) {
+        int ret = avcodec_send_packet(context_, packet);
+        if (ret < 0 && ret != AVERROR_EOF) {
+            LOG(WARNING) << "H.264 decoder rejected packet (" << ret << ")";
+            g_stats.frames_decode_failed++;
+            return ret == AVERROR_INVALIDDATA;  // Corrupt slice: keep going with the next one
+        }
+        
+        while ((ret = avcodec_receive_frame(context_, frame_)) >= 0) {
+            if (convertFrame()) {
+                g_stats.frames_decoded++;
+                on_frame(bgr_);
+            }
+            av_frame_unref(frame_);
+        }
+        return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+    }
+    
+    /**
+     * Copy the 4:2:0 planes into one contiguous I420 buffer and convert to BGR.
+     */
+    bool convertFrame() {
+        if (frame_->format != AV_PIX_FMT_YUV420P && frame_->format != AV_PIX_FMT_YUVJ420P) {
+            LOG_FIRST_N(WARNING, 1) << "Unsupported H.264 pixel format " << frame_->format;
+            g_stats.frames_decode_failed++;
+            return false;
+        }
+        
+        TraceSpan span("h264_convert");
+        int width = frame_->width & ~1;
+        int height = frame_->height & ~1;
+        i420_.create(height * 3 / 2, width, CV_8UC1);
+        uint8_t* out = i420_.data;
+        for (int row = 0; row < height; ++row, out += width) {
+            std::memcpy(out, frame_->data[0] + row * frame_->linesize[0], width);
+        }
+        for (int plane = 1; plane <= 2; ++plane) {
+            for (int row = 0; row < height / 2; ++row, out += width / 2) {
+                std::memcpy(out, frame_->data[plane] + row * frame_->linesize[plane], width / 2);
+            }
+        }
+        cv::cvtColor(i420_, bgr_, cv::COLOR_YUV2BGR_I420);
+        return true;
+    }
+    
+    AVCodecParserContext* parser_ = nullptr;
+    AVCodecContext* context_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    std::vector<uint8_t> input_;  // Padded copy of the chunk being parsed
+    cv::Mat i420_;  // Reused across pictures
+    cv::Mat bgr_;
+};
+
+#else
+
+/**
+ * Placeholder when built without libavcodec: H.264 sessions are refused.
+ */
+class H264StreamDecoder {
+public:
+    using FrameCallback = std::function<void(const cv::Mat&)>;
+    static std::unique_ptr<H264StreamDecoder> create() { return nullptr; }
+    bool decode(const uint8_t*, size_t, const FrameCallback&) { return false; }
+    void flush(const FrameCallback&) {}
+};
+
+#endif  // PRESAGE_HAVE_LIBAVCODEC
+
+// ============================================================================
+// Frame Transcode Pool - Parallel decode/resize with in-order commit
+// ============================================================================
+
+/**
+ * One frame moving through the transcode pool.
+ */
+struct TranscodeTask {
+    uint64_t seq = 0;
+    const uint8_t* data = nullptr;  // Encoded bytes (into `owned` or borrowed stable storage)
+    size_t length = 0;
+    PooledMat owned;                // Payload copy when the source buffer is about to be reused
+    PipelineTimestamps::Clock::time_point received_at;
+    int64_t client_timestamp_us = -1;    // Capture time from a raw frame header, if any
+    std::function<void()> on_committed;  // Runs after commit, in submission order
+    
+    PooledMat frame;  // Decoded (and resized) output
+    bool ok = false;
+};
+
+/**
+ * Decodes and resizes frames on a worker pool, then commits them to the
+ * recorder strictly in submission order.
+ * 
+ * Workers pull from one shared queue (frames cost about the same, so stealing
+ * buys nothing here). Finished frames park in a sequence-keyed reorder map;
+ * whichever worker completes the next expected sequence number drains the run
+ * of ready frames while the others keep decoding. submit() blocks once
+ * `max_in_flight` frames are outstanding, pushing back on the socket.
+ */
+class FrameTranscodePool {
+public:
+    using Stage = std::function<void(TranscodeTask&)>;
+    
+    FrameTranscodePool(size_t threads, Stage transcode, Stage commit)
+        : transcode_(std::move(transcode)), commit_(std::move(commit)),
+          max_in_flight_(threads * 2) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back(&FrameTranscodePool::workerLoop, this, i);
+        }
+        LOG(INFO) << "Frame transcode pool started with " << threads << " workers";
+    }
+    
+    ~FrameTranscodePool() {
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+    
+    void submit(std::unique_ptr<TranscodeTask> task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        progress_cv_.wait(lock, [this]() { return next_seq_ - next_commit_ < max_in_flight_; });
+        task->seq = next_seq_++;
+        pending_.push_back(std::move(task));
+        work_cv_.notify_one();
+    }
+    
+    /**
+     * Wait until every frame submitted before this call has been committed.
+     */
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t target = next_seq_;
+        progress_cv_.wait(lock, [this, target]() { return next_commit_ >= target; });
+    }
+    
+private:
+    void workerLoop(size_t index) {
+        PipelineTracer::instance().setThreadName("transcode_" + std::to_string(index));
         
-        // Check if apnea was detected in the most recent apnea event
-        bool apnea_detected = false;
-        if (metrics.breathing().apnea_size() > 0) {
-            // Get the most recent apnea event
-            const auto& last_apnea = metrics.breathing().apnea(metrics.breathing().apnea_size() - 1);
-            apnea_detected = last_apnea.detected();
+        while (true) {
+            std::unique_ptr<TranscodeTask> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+                if (pending_.empty()) {
+                    return;
+                }
+                task = std::move(pending_.front());
+                pending_.pop_front();
+            }
+            
+            transcode_(*task);
+            complete(std::move(task));
         }
-        j["apnea_detected"] = apnea_detected;
-        
-        // =====================================================================
-        // FACE METRICS
-        // =====================================================================
-        
-        // Check if blinking was detected in the most recent blinking event
-        bool blinking = false;
-        if (metrics.face().blinking_size() > 0) {
-            // Get the most recent blink event
-            const auto& last_blink = metrics.face().blinking(metrics.face().blinking_size() - 1);
-            blinking = last_blink.detected();
+    }
+    
+    void complete(std::unique_ptr<TranscodeTask> task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t seq = task->seq;
+        ready_.emplace(seq, std::move(task));
+        if (committing_) {
+            return;  // The active committer will pick this frame up
         }
-        j["blinking"] = blinking;
         
-        // Check if talking was detected in the most recent talking event
-        bool talking = false;
-        if (metrics.face().talking_size() > 0) {
-            // Get the most recent talking event
-            const auto& last_talk = metrics.face().talking(metrics.face().talking_size() - 1);
-            talking = last_talk.detected();
+        committing_ = true;
+        while (!ready_.empty() && ready_.begin()->first == next_commit_) {
+            std::unique_ptr<TranscodeTask> next = std::move(ready_.begin()->second);
+            ready_.erase(ready_.begin());
+            
+            lock.unlock();
+            commit_(*next);
+            if (next->on_committed) {
+                next->on_committed();
+            }
+            next.reset();
+            lock.lock();
+            
+            next_commit_++;
+            progress_cv_.notify_all();
         }
-        j["talking"] = talking;
-        
-        // =====================================================================
-        // ADDITIONAL METADATA
-        // =====================================================================
-        
-        // Include measurement metadata if available
-        if (metrics.has_metadata()) {
-            j["measurement_id"] = metrics.metadata().id();
-            j["upload_timestamp"] = metrics.metadata().upload_timestamp();
+        committing_ = false;
+    }
+    
+    Stage transcode_;
+    Stage commit_;
+    size_t max_in_flight_;
+    std::vector<std::thread> workers_;
+    
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable progress_cv_;
+    std::deque<std::unique_ptr<TranscodeTask>> pending_;
+    std::map<uint64_t, std::unique_ptr<TranscodeTask>> ready_;
+    uint64_t next_seq_ = 0;
+    uint64_t next_commit_ = 0;
+    bool committing_ = false;
+    bool stopping_ = false;
+};
+
+// ============================================================================
+// Stream Frame Reader - Batched receive for the length-prefixed video protocol
+// ============================================================================
+
+/**
+ * Buffered reader for 4-byte big-endian length-prefixed messages.
+ * 
+ * Each recv() pulls whatever the socket has ready into one reusable buffer, so
+ * a header and its payload - and often several queued frames - arrive in a
+ * single syscall instead of two MSG_WAITALL calls per frame. Payloads are
+ * returned as pointers into the buffer; no extra copy is made.
+ */
+class StreamFrameReader {
+public:
+    StreamFrameReader(int fd, size_t max_message_bytes, size_t read_chunk_bytes = 256 * 1024)
+        : fd_(fd), max_message_bytes_(max_message_bytes), buffer_(read_chunk_bytes),
+          start_(0), end_(0) {}
+    
+    /**
+     * Read the next message.
+     * 
+     * @param data Receives a pointer to the payload (valid until the next call)
+     * @param length Receives the payload length
+     * @return false on disconnect or an oversized message
+     */
+    bool next(const uint8_t** data, uint32_t* length) {
+        if (!fill(4)) {
+            return false;
         }
         
-        // =====================================================================
-        // BLOOD PRESSURE (if enabled and available)
-        // =====================================================================
+        const uint8_t* header = buffer_.data() + start_;
+        uint32_t message_length = (header[0] << 24) | (header[1] << 16) |
+                                  (header[2] << 8) | header[3];
+        if (message_length > max_message_bytes_) {
+            LOG(WARNING) << "Frame too large: " << message_length;
+            return false;
+        }
         
-        // Note: Blood pressure requires enable_phasic_bp = true in settings
-        if (metrics.has_blood_pressure() && metrics.blood_pressure().phasic_size() > 0) {
-            const auto& last_bp = metrics.blood_pressure().phasic(metrics.blood_pressure().phasic_size() - 1);
-            j["phasic_blood_pressure"] = last_bp.value();
+        if (!fill(4 + static_cast<size_t>(message_length))) {
+            return false;
         }
         
-        return j.dump();
+        *data = buffer_.data() + start_ + 4;
+        *length = message_length;
+        start_ += 4 + message_length;
+        return true;
     }
     
-    void broadcastError(const std::string& session_id, const std::string& error) {
-        if (g_metrics_server) {
-            json error_msg;
-            error_msg["type"] = "sdk_status";
-            error_msg["status"] = "error";
-            error_msg["session_id"] = session_id;
-            error_msg["error"] = error;
-            error_msg["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count();
-            g_metrics_server->broadcast(error_msg.dump());
+private:
+    // Ensure at least `needed` unread bytes are buffered
+    bool fill(size_t needed) {
+        if (end_ - start_ >= needed) {
+            return true;
+        }
+        
+        // Move the unread tail to the front, growing only for oversized frames
+        if (start_ > 0) {
+            std::memmove(buffer_.data(), buffer_.data() + start_, end_ - start_);
+            end_ -= start_;
+            start_ = 0;
+        }
+        if (buffer_.size() < needed) {
+            buffer_.resize(needed);
         }
+        
+        while (end_ < needed) {
+            ssize_t received = recv(fd_, buffer_.data() + end_, buffer_.size() - end_, 0);
+            g_stats.recv_calls++;
+            if (received <= 0) {
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            end_ += received;
+        }
+        return true;
     }
     
-    std::string api_key_;
-    int frame_width_;
-    int frame_height_;
-    
-    std::atomic<bool> processing_;
-    std::atomic<bool> shutdown_;
-    std::string current_session_id_;
-    std::thread processing_thread_;
-    
-    // Queue for segment processing
-    std::queue<ProcessingJob> processing_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
-    std::thread worker_thread_;
+    int fd_;
+    size_t max_message_bytes_;
+    std::vector<uint8_t> buffer_;
+    size_t start_;
+    size_t end_;
 };
 
 // TCP Server for video input
 class VideoInputServer {
 public:
-    VideoInputServer(int port) : port_(port), server_fd_(-1), running_(false) {}
+    /**
+     * @param port TCP port to listen on
+     * @param unix_path Optional AF_UNIX socket path served by the same client handler
+     * @param unix_type SOCK_STREAM (length-prefixed, like TCP) or SOCK_SEQPACKET
+     *                  (one frame or control message per packet, no prefix)
+     */
+    VideoInputServer(int port, const std::string& unix_path = "", int unix_type = SOCK_STREAM)
+        : port_(port), server_fd_(-1), unix_path_(unix_path), unix_type_(unix_type), unix_fd_(-1),
+          running_(false) {}
     
     ~VideoInputServer() {
         stop();
@@ -1192,6 +6362,23 @@ public:
             return false;
         }
         
+        if (!unix_path_.empty()) {
+            unix_fd_ = create_unix_listener(unix_path_, unix_type_, 1);
+            if (unix_fd_ < 0) {
+                close(server_fd_);
+                return false;
+            }
+            LOG(INFO) << "Video input server listening on unix socket " << unix_path_
+                      << " (" << socket_type_name(unix_type_) << ")";
+        }
+        
+        if (transcode_threads_ > 0) {
+            transcode_pool_ = std::make_unique<FrameTranscodePool>(
+                transcode_threads_,
+                [this](TranscodeTask& task) { transcodeFrame(task); },
+                [this](TranscodeTask& task) { commitFrame(task); });
+        }
+        
         running_ = true;
         server_thread_ = std::thread(&VideoInputServer::acceptAndReceive, this);
         
@@ -1206,23 +6393,63 @@ public:
             close(server_fd_);
             server_fd_ = -1;
         }
+        if (unix_fd_ >= 0) {
+            close(unix_fd_);
+            unix_fd_ = -1;
+            unlink(unix_path_.c_str());
+        }
         if (server_thread_.joinable()) {
             server_thread_.join();
         }
+        detachShmRing();
+        transcode_pool_.reset();
+    }
+    
+    bool isRunning() const {
+        return running_.load();
+    }
+    
+    /**
+     * Decode/resize frames on this many worker threads (0 = inline on the
+     * ingest thread). Must be called before start().
+     */
+    void setTranscodeThreads(size_t threads) {
+        transcode_threads_ = threads;
+    }
+    
+    /**
+     * Push an unsolicited message (e.g. quality_feedback) to the connected
+     * video client, if any. Safe to call from any thread. The message is
+     * dropped rather than waited on when the client's socket buffer is full.
+     *
+     * @return true if the message was sent
+     */
+    bool sendToClient(const json& message) {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (client_fd_ < 0) {
+            return false;
+        }
+        // Best effort: a client that isn't reading must not stall the caller
+        return writeMessage(client_fd_, message.dump(), true);
     }
     
 private:
     void acceptAndReceive() {
+        PipelineTracer::instance().setThreadName("ingest");
+        
         while (running_ && g_running) {
             fd_set readfds;
             FD_ZERO(&readfds);
             FD_SET(server_fd_, &readfds);
+            if (unix_fd_ >= 0) {
+                FD_SET(unix_fd_, &readfds);
+            }
             
             struct timeval tv;
             tv.tv_sec = 1;
             tv.tv_usec = 0;
             
-            int activity = select(server_fd_ + 1, &readfds, NULL, NULL, &tv);
+            int activity = select(std::max(server_fd_, unix_fd_) + 1, &readfds, NULL, NULL, &tv);
             
             if (activity < 0 && errno != EINTR) {
                 continue;
@@ -1235,82 +6462,450 @@ private:
                 
                 if (client_fd >= 0) {
                     LOG(INFO) << "Video client connected from " << inet_ntoa(client_addr.sin_addr);
-                    handleVideoClient(client_fd);
-                    close(client_fd);
+                    client_seqpacket_ = false;
+                    serveClient(client_fd);
+                    LOG(INFO) << "Video client disconnected";
+                }
+            }
+            
+            if (activity > 0 && unix_fd_ >= 0 && FD_ISSET(unix_fd_, &readfds)) {
+                int client_fd = accept(unix_fd_, NULL, NULL);
+                
+                if (client_fd >= 0) {
+                    LOG(INFO) << "Video client connected on " << unix_path_;
+                    client_seqpacket_ = (unix_type_ == SOCK_SEQPACKET);
+                    serveClient(client_fd);
                     LOG(INFO) << "Video client disconnected";
                 }
             }
         }
     }
     
+    /**
+     * Receive one SEQPACKET message into buffer (one recv, no length prefix).
+     * 
+     * @return Message length, or -1 on disconnect / oversized message
+     */
+    ssize_t receivePacket(int client_fd, std::vector<uint8_t>& buffer) {
+        if (buffer.size() < kMaxFrameBytes) {
+            buffer.resize(kMaxFrameBytes);
+        }
+        // MSG_TRUNC makes recv report the real packet size even if it didn't fit
+        ssize_t received = recv(client_fd, buffer.data(), buffer.size(), MSG_TRUNC);
+        if (received <= 0) {
+            return -1;
+        }
+        if (static_cast<size_t>(received) > buffer.size()) {
+            LOG(WARNING) << "Frame too large: " << received;
+            return -1;
+        }
+        return received;
+    }
+    
+    /**
+     * Serve one client until it disconnects. The fd is published so other
+     * threads can push messages to it (see sendToClient).
+     */
+    void serveClient(int client_fd) {
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            client_fd_ = client_fd;
+        }
+        handleVideoClient(client_fd);
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            client_fd_ = -1;
+        }
+        close(client_fd);
+    }
+    
     void handleVideoClient(int client_fd) {
         std::vector<uint8_t> buffer;
-        uint8_t header[4];
         
-        while (running_ && g_running) {
-            // Read 4-byte frame length header
-            ssize_t received = recv(client_fd, header, 4, MSG_WAITALL);
-            if (received != 4) {
+        while (running_ && g_running && client_seqpacket_) {
+            auto recv_started = PipelineTracer::Clock::now();
+            ssize_t length = receivePacket(client_fd, buffer);
+            if (length < 0) {
                 break;
             }
+            auto received_at = PipelineTimestamps::Clock::now();
+            PipelineTracer::instance().record("recv", recv_started, received_at, length);
             
-            // Parse frame length (big-endian)
-            uint32_t frame_length = (header[0] << 24) | (header[1] << 16) | 
-                                    (header[2] << 8) | header[3];
-            
-            if (frame_length > 10 * 1024 * 1024) {  // Max 10MB per frame
-                LOG(WARNING) << "Frame too large: " << frame_length;
-                break;
+            if (length > 0 && buffer[0] == '{') {
+                drainTranscodes();
+                handleControlMessage(std::string(buffer.begin(), buffer.begin() + length), client_fd);
+                continue;
             }
             
-            // Read payload data
-            buffer.resize(frame_length);
-            received = recv(client_fd, buffer.data(), frame_length, MSG_WAITALL);
-            if (received != static_cast<ssize_t>(frame_length)) {
+            g_stats.bytes_received += length;
+            handleFramePayload(buffer.data(), length, received_at);
+        }
+        
+        // Length-prefixed stream (TCP or unix stream): 4-byte big-endian length + payload
+        StreamFrameReader reader(client_fd, kMaxFrameBytes);
+        while (running_ && g_running && !client_seqpacket_) {
+            auto recv_started = PipelineTracer::Clock::now();
+            const uint8_t* payload = nullptr;
+            uint32_t frame_length = 0;
+            if (!reader.next(&payload, &frame_length)) {
                 break;
             }
+            auto received_at = PipelineTimestamps::Clock::now();
+            PipelineTracer::instance().record("recv", recv_started, received_at, frame_length);
             
             // Check if payload is a JSON control message (starts with '{')
-            if (frame_length > 0 && buffer[0] == '{') {
-                // Parse and handle control message
-                std::string json_str(buffer.begin(), buffer.end());
+            if (frame_length > 0 && payload[0] == '{') {
+                // Parse and handle control message once earlier frames are committed
+                std::string json_str(reinterpret_cast<const char*>(payload), frame_length);
+                drainTranscodes();
                 handleControlMessage(json_str, client_fd);
                 continue;
             }
             
             // Otherwise, decode as JPEG frame
-            cv::Mat frame = cv::imdecode(buffer, cv::IMREAD_COLOR);
-            if (frame.empty()) {
-                LOG(WARNING) << "Failed to decode frame";
+            g_stats.bytes_received += 4 + frame_length;
+            handleFramePayload(payload, frame_length, received_at);
+        }
+        
+        // Frames still sitting in a shared-memory ring belong to this client
+        if (shm_ring_) {
+            shm_ring_->waitDrained(1000);
+            detachShmRing();
+        }
+        drainTranscodes();
+        closeH264Decoder();
+        
+        // If session was active when client disconnected, stop recording
+        // The final segment will be automatically queued for processing
+        if (g_session_recorder && g_session_recorder->isRecording()) {
+            std::string session_id = g_session_recorder->getCurrentSessionId();
+            size_t frame_count = g_session_recorder->getFrameCount();
+            std::string final_segment = g_session_recorder->stopRecording();
+            
+            LOG(INFO) << "Video client disconnected - stopped recording session " << session_id
+                      << " (" << frame_count << " total frames)"
+                      << " - final segment queued for processing";
+        }
+    }
+    
+    /**
+     * Decode one JPEG payload and hand it to the session recorder.
+     * 
+     * With a transcode pool the frame is decoded on a worker and committed in
+     * order; otherwise it is decoded inline. Bytes are decoded in place where
+     * possible.
+     * 
+     * @param on_committed If set, `data` stays valid until this runs (e.g. a
+     *                     shared-memory slot); otherwise the bytes are copied
+     *                     before the caller's buffer is reused.
+     */
+    void handleFramePayload(const uint8_t* data, size_t length,
+                            PipelineTimestamps::Clock::time_point received_at,
+                            std::function<void()> on_committed = nullptr) {
+        g_stats.frames_received++;
+        
+        {
+            std::lock_guard<std::mutex> lock(h264_mutex_);
+            if (h264_decoder_) {
+                handleH264Chunk(data, length, received_at);
+                if (on_committed) {
+                    on_committed();
+                }
+                return;
+            }
+        }
+        
+        auto task = std::make_unique<TranscodeTask>();
+        task->data = data;
+        task->length = length;
+        task->received_at = received_at;
+        task->on_committed = std::move(on_committed);
+        
+        if (!transcode_pool_) {
+            transcodeFrame(*task);
+            commitFrame(*task);
+            if (task->on_committed) {
+                task->on_committed();
+            }
+            return;
+        }
+        
+        if (!task->on_committed && g_frame_pool) {
+            task->owned = g_frame_pool->acquire(cv::Size(static_cast<int>(length), 1), CV_8UC1);
+            if (task->owned.mat.empty()) {
+                task->owned.mat.create(1, static_cast<int>(length), CV_8UC1);
+            }
+            std::memcpy(task->owned.mat.data, data, length);
+            task->data = task->owned.mat.data;
+        } else if (!task->on_committed) {
+            task->owned.mat.create(1, static_cast<int>(length), CV_8UC1);
+            std::memcpy(task->owned.mat.data, data, length);
+            task->data = task->owned.mat.data;
+        }
+        transcode_pool_->submit(std::move(task));
+    }
+    
+    /**
+     * Decode (and resize to the recording resolution) one frame.
+     * Runs on a transcode worker, or inline without a pool.
+     */
+    void transcodeFrame(TranscodeTask& task) {
+        cv::Size target = g_session_recorder ? g_session_recorder->getFrameSize() : cv::Size();
+        
+        // Optional capture-time prefix: "PTS1" + 8-byte big-endian microseconds
+        if (task.length > kTimestampPrefixBytes && std::memcmp(task.data, "PTS1", 4) == 0) {
+            uint64_t capture_us = 0;
+            for (size_t i = 4; i < kTimestampPrefixBytes; ++i) {
+                capture_us = (capture_us << 8) | task.data[i];
+            }
+            task.client_timestamp_us = capture_us > 0 ? static_cast<int64_t>(capture_us) : -1;  // 0 = unknown
+            task.data += kTimestampPrefixBytes;
+            task.length -= kTimestampPrefixBytes;
+        }
+        
+        RawFrameHeader raw;
+        if (parse_raw_frame_header(task.data, task.length, &raw)) {
+            if (raw.timestamp_us > 0) {  // 0 = unknown: fall back to the arrival clock
+                task.client_timestamp_us = static_cast<int64_t>(raw.timestamp_us);
+            }
+            task.ok = convertRawFrame(task, raw);
+        } else {
+            task.ok = decodeJpegFrame(task, target);
+        }
+        if (!task.ok) {
+            g_stats.frames_decode_failed++;
+            LOG(WARNING) << "Failed to decode frame";
+            return;
+        }
+        g_stats.frames_decoded++;
+        
+        // Resize here so the serial commit stage only has to encode
+        if (!target.empty() && task.frame.mat.size() != target && g_frame_pool) {
+            TraceSpan span("resize");
+            PooledMat resized = g_frame_pool->acquire(target, CV_8UC3);
+            cv::resize(task.frame.mat, resized.mat, target);
+            if (!resized.pooled()) {
+                g_stats.resize_allocations++;
+            }
+            g_stats.frames_resized++;
+            task.frame = std::move(resized);
+        }
+    }
+    
+    bool decodeJpegFrame(TranscodeTask& task, cv::Size target) {
+        // When the recording is smaller than the input, decode at the coarsest
+        // DCT scale that still covers it and leave only a small resize
+        int decode_flag = cv::IMREAD_COLOR;
+        int jpeg_width = 0;
+        int jpeg_height = 0;
+        if (!target.empty() && jpeg_dimensions(task.data, task.length, &jpeg_width, &jpeg_height)) {
+            decode_flag = reduced_decode_flag(jpeg_width, jpeg_height, target);
+        }
+        
+        // Decode straight into pooled storage sized like the previous frame;
+        // imdecode only reallocates if this frame's size differs
+        if (g_frame_pool) {
+            uint64_t packed = last_decoded_size_.load(std::memory_order_relaxed);
+            task.frame = g_frame_pool->acquire(cv::Size(static_cast<int>(packed >> 32),
+                                                        static_cast<int>(packed & 0xFFFFFFFF)), CV_8UC3);
+        }
+        {
+            TraceSpan span("imdecode");
+            cv::Mat encoded(1, static_cast<int>(task.length), CV_8UC1, const_cast<uint8_t*>(task.data));
+            if (cv::imdecode(encoded, decode_flag, &task.frame.mat).empty()) {
+                return false;
+            }
+        }
+        if (!task.frame.pooled()) {
+            g_stats.decode_allocations++;
+        }
+        last_decoded_size_.store((static_cast<uint64_t>(task.frame.mat.cols) << 32) |
+                                 static_cast<uint32_t>(task.frame.mat.rows), std::memory_order_relaxed);
+        if (decode_flag != cv::IMREAD_COLOR) {
+            g_stats.frames_reduced_decode++;
+        }
+        return true;
+    }
+    
+    /**
+     * Convert a raw NV12/I420 payload to BGR. The planes are read in place;
+     * only I420 with padded rows has to be repacked first, since OpenCV
+     * expects its chroma planes at half the luma width.
+     */
+    bool convertRawFrame(TranscodeTask& task, const RawFrameHeader& raw) {
+        TraceSpan span("yuv_convert");
+        int width = static_cast<int>(raw.width);
+        int height = static_cast<int>(raw.height);
+        const uint8_t* planes = task.data + kRawFrameHeaderBytes;
+        
+        cv::Mat yuv;
+        cv::Mat repacked;
+        if (raw.format == RawPixelFormat::kNV12) {
+            // Interleaved UV rows share the luma stride, so one strided view covers both planes
+            yuv = cv::Mat(height * 3 / 2, width, CV_8UC1, const_cast<uint8_t*>(planes), raw.stride);
+        } else if (raw.stride == raw.width) {
+            yuv = cv::Mat(height * 3 / 2, width, CV_8UC1, const_cast<uint8_t*>(planes));
+        } else {
+            repacked.create(height * 3 / 2, width, CV_8UC1);
+            uint8_t* out = repacked.data;
+            const uint8_t* in = planes;
+            for (int row = 0; row < height; ++row, in += raw.stride, out += width) {
+                std::memcpy(out, in, width);
+            }
+            size_t chroma_stride = raw.stride / 2;
+            for (int row = 0; row < height; ++row, in += chroma_stride, out += width / 2) {
+                std::memcpy(out, in, width / 2);  // U rows, then V rows
+            }
+            yuv = repacked;
+        }
+        
+        if (g_frame_pool) {
+            task.frame = g_frame_pool->acquire(cv::Size(width, height), CV_8UC3);
+        }
+        cv::cvtColor(yuv, task.frame.mat,
+                     raw.format == RawPixelFormat::kNV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+        g_stats.frames_raw++;
+        return !task.frame.mat.empty();
+    }
+    
+    /**
+     * Feed an H.264 chunk to the session decoder and record each completed
+     * picture. Caller holds h264_mutex_.
+     */
+    void handleH264Chunk(const uint8_t* data, size_t length,
+                         PipelineTimestamps::Clock::time_point received_at) {
+        TraceSpan span("h264_decode", static_cast<int64_t>(length));
+        bool ok = h264_decoder_->decode(data, length, [received_at](const cv::Mat& frame) {
+            if (g_session_recorder) {
+                g_session_recorder->addFrame(frame, received_at);
+            }
+        });
+        if (!ok) {
+            LOG(WARNING) << "Failed to decode H.264 chunk (" << length << " bytes)";
+        }
+    }
+    
+    /**
+     * Flush and drop the session's H.264 decoder, recording any pictures it
+     * was still holding.
+     */
+    void closeH264Decoder() {
+        std::lock_guard<std::mutex> lock(h264_mutex_);
+        if (!h264_decoder_) {
+            return;
+        }
+        auto flushed_at = PipelineTimestamps::Clock::now();
+        h264_decoder_->flush([flushed_at](const cv::Mat& frame) {
+            if (g_session_recorder) {
+                g_session_recorder->addFrame(frame, flushed_at);
+            }
+        });
+        h264_decoder_.reset();
+    }
+    
+    /**
+     * Record a transcoded frame. Called in submission order.
+     */
+    void commitFrame(TranscodeTask& task) {
+        // Record frame to session video file (if session is active)
+        if (task.ok && g_session_recorder) {
+            g_session_recorder->addFrame(task.frame.mat, task.received_at, task.client_timestamp_us);
+        }
+    }
+    
+    void drainTranscodes() {
+        if (transcode_pool_) {
+            transcode_pool_->drain();
+        }
+    }
+    
+    /**
+     * Consume frames from the shared-memory ring until detached.
+     */
+    void shmReaderLoop() {
+        PipelineTracer::instance().setThreadName("shm_ingest");
+        
+        while (shm_running_ && running_ && g_running) {
+            const uint8_t* payload = nullptr;
+            const ShmFrameRing::SlotHeader* slot = shm_ring_->waitForSlot(100, &payload);
+            if (!slot) {
                 continue;
             }
             
-            // Record frame to session video file (if session is active)
-            if (g_session_recorder) {
-                g_session_recorder->addFrame(frame);
+            auto received_at = PipelineTimestamps::Clock::now();
+            ShmFrameRing* ring = shm_ring_.get();
+            // Read the length once: the producer can rewrite the slot header
+            // between a check and a use
+            uint32_t length = *reinterpret_cast<const volatile uint32_t*>(&slot->length);
+            if (length > 0 && length <= ring->slotSize()) {
+                g_stats.bytes_received += length;
+                // The slot stays taken until its frame is committed, so workers
+                // decode straight out of shared memory
+                handleFramePayload(payload, length, received_at, [ring]() { ring->releaseSlot(); });
+            } else {
+                LOG(WARNING) << "Ignoring shm slot with invalid length " << length;
+                ring->releaseSlot();
             }
-            
         }
+    }
+    
+    void detachShmRing() {
+        shm_running_ = false;
+        if (shm_thread_.joinable()) {
+            shm_thread_.join();
+        }
+        // In-flight frames may still point into the ring
+        drainTranscodes();
+        if (shm_ring_) {
+            LOG(INFO) << "Detached shared-memory frame ring " << shm_ring_->name();
+            shm_ring_.reset();
+        }
+    }
+    
+    /**
+     * Handle shm_attach control message.
+     * Creates a frame ring the client can write JPEG frames into instead of
+     * sending them over the socket. The TCP path keeps working alongside it.
+     */
+    void handleShmAttach(const json& msg, int client_fd) {
+        detachShmRing();
         
-        // If session was active when client disconnected, stop recording
-        // The final segment will be automatically queued for processing
-        if (g_session_recorder && g_session_recorder->isRecording()) {
-            std::string session_id = g_session_recorder->getCurrentSessionId();
-            size_t frame_count = g_session_recorder->getFrameCount();
-            std::string final_segment = g_session_recorder->stopRecording();
-            
-            LOG(INFO) << "Video client disconnected - stopped recording session " << session_id
-                      << " (" << frame_count << " total frames)"
-                      << " - final segment queued for processing";
+        uint32_t slots = msg.value("slots", 8u);
+        uint32_t slot_size = msg.value("slot_size", 1024u * 1024u);
+        std::string name = "/presage_frames_" + std::to_string(getpid()) + "_" +
+                           std::to_string(++shm_ring_counter_);
+        
+        shm_ring_ = ShmFrameRing::create(name, slots, slot_size);
+        if (!shm_ring_) {
+            sendControlResponse(client_fd, "error", "Failed to create shared-memory frame ring");
+            return;
         }
+        
+        shm_running_ = true;
+        shm_thread_ = std::thread(&VideoInputServer::shmReaderLoop, this);
+        
+        LOG(INFO) << "Attached shared-memory frame ring " << name
+                  << " (" << slots << " x " << slot_size << " bytes)";
+        
+        json response;
+        response["type"] = "shm_attached";
+        response["name"] = name;
+        response["slots"] = slots;
+        response["slot_size"] = slot_size;
+        response["header_bytes"] = ShmFrameRing::kHeaderBytes;
+        response["slot_header_bytes"] = ShmFrameRing::kSlotHeaderBytes;
+        sendControlResponse(client_fd, response);
     }
     
     /**
      * Handle a JSON control message from the video client.
      * 
      * Supported messages:
-     * - {"type":"session_start","session_id":"...","fps":30,"width":1280,"height":720}
+     * - {"type":"session_start","session_id":"...","fps":30,"width":1280,"height":720,"codec":"jpeg"|"h264","recording_codec":"mjpg","segment_ramp":[2,3]}
      * - {"type":"session_end","session_id":"..."}
+     * - {"type":"trace","action":"start"|"stop","path":"..."}
+     * - {"type":"shm_attach","slots":8,"slot_size":1048576}
+     * - {"type":"shm_detach"}
      */
     void handleControlMessage(const std::string& json_str, int client_fd) {
         try {
@@ -1321,6 +6916,18 @@ private:
                 handleSessionStart(msg, client_fd);
             } else if (msg_type == "session_end") {
                 handleSessionEnd(msg, client_fd);
+            } else if (msg_type == "trace") {
+                handleTrace(msg, client_fd);
+            } else if (msg_type == "shm_attach") {
+                handleShmAttach(msg, client_fd);
+            } else if (msg_type == "shm_detach") {
+                if (shm_ring_) {
+                    shm_ring_->waitDrained(1000);
+                }
+                detachShmRing();
+                json response;
+                response["type"] = "shm_detached";
+                sendControlResponse(client_fd, response);
             } else {
                 LOG(WARNING) << "Unknown control message type: " << msg_type;
                 sendControlResponse(client_fd, "error", "Unknown message type: " + msg_type);
@@ -1357,6 +6964,13 @@ private:
         int fps = msg.value("fps", 0);
         int width = msg.value("width", 0);
         int height = msg.value("height", 0);
+        std::string codec = msg.value("codec", "jpeg");
+        std::string recording_codec_str = msg.value("recording_codec", "");
+        RecordingCodec recording_codec = RecordingCodec::kMJPG;
+        if (!recording_codec_str.empty() && !parse_recording_codec(recording_codec_str, &recording_codec)) {
+            sendControlResponse(client_fd, "error", "Unsupported recording codec: " + recording_codec_str);
+            return;
+        }
         
         // Check if already recording
         if (g_session_recorder->isRecording()) {
@@ -1367,8 +6981,35 @@ private:
             return;
         }
         
+        std::vector<double> ramp_seconds;
+        bool has_ramp = msg.contains("segment_ramp");
+        if (has_ramp) {
+            for (const auto& entry : msg["segment_ramp"]) {
+                ramp_seconds.push_back(entry.is_string() && entry.get<std::string>() == "min" ? 0.0
+                                                                                             : entry.get<double>());
+            }
+        }
+        
+        std::unique_ptr<H264StreamDecoder> h264_decoder;
+        if (codec == "h264") {
+            h264_decoder = H264StreamDecoder::create();
+            if (!h264_decoder) {
+                sendControlResponse(client_fd, "error", "H.264 ingest is not available in this build");
+                return;
+            }
+        } else if (codec != "jpeg") {
+            sendControlResponse(client_fd, "error", "Unsupported codec: " + codec);
+            return;
+        }
+        
         // Start recording
-        if (g_session_recorder->startSession(session_id, fps, width, height)) {
+        if (g_session_recorder->startSession(session_id, fps, width, height,
+                                             recording_codec_str.empty() ? nullptr : &recording_codec,
+                                             has_ramp ? &ramp_seconds : nullptr)) {
+            {
+                std::lock_guard<std::mutex> lock(h264_mutex_);
+                h264_decoder_ = std::move(h264_decoder);
+            }
             LOG(INFO) << "Started session: " << session_id 
                       << " (fps=" << fps << ", " << width << "x" << height << ")";
             
@@ -1376,6 +7017,12 @@ private:
             response["type"] = "session_started";
             response["session_id"] = session_id;
             response["video_path"] = g_session_recorder->getCurrentVideoPath();
+            response["codec"] = codec;
+            response["recording_codec"] = recording_codec_name(g_session_recorder->getSessionCodec());
+            std::vector<size_t> plan = g_session_recorder->getSegmentPlan();
+            response["segment_frames"] = plan.back();
+            plan.pop_back();
+            response["segment_ramp_frames"] = plan;
             sendControlResponse(client_fd, response);
         } else {
             sendControlResponse(client_fd, "error", "Failed to start session");
@@ -1411,6 +7058,12 @@ private:
             return;
         }
         
+        // Frames written to the shm ring before session_end must land in this session
+        if (shm_ring_ && !shm_ring_->waitDrained(1000)) {
+            LOG(WARNING) << "Shared-memory ring not drained before session end";
+        }
+        closeH264Decoder();
+        
         // Stop recording - this finalizes the last segment and queues it for processing
         size_t frame_count = g_session_recorder->getFrameCount();
         std::string final_segment_path = g_session_recorder->stopRecording();
@@ -1443,6 +7096,67 @@ private:
         sendControlResponse(client_fd, response);
     }
     
+    /**
+     * Handle trace control message.
+     * Starts or stops pipeline tracing; stopping writes the Chrome trace JSON.
+     */
+    void handleTrace(const json& msg, int client_fd) {
+        std::string action = msg.value("action", "");
+        PipelineTracer& tracer = PipelineTracer::instance();
+        
+        if (action == "start") {
+            auto now = std::chrono::system_clock::now();
+            auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+                now.time_since_epoch()).count();
+            // Clients only name a new trace_*.json file; it always lands in the
+            // traces directory, so no recording or journal can be overwritten
+            std::string name = msg.value("path", "trace_" + std::to_string(timestamp) + ".json");
+            const std::string prefix = "trace_";
+            const std::string suffix = ".json";
+            bool valid = name.size() > prefix.size() + suffix.size() &&
+                         name.compare(0, prefix.size(), prefix) == 0 &&
+                         name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+                         std::all_of(name.begin(), name.end(), [](unsigned char c) {
+                             return std::isalnum(c) || c == '_' || c == '-' || c == '.';
+                         });
+            if (!valid) {
+                sendControlResponse(client_fd, "error", "Trace path must be a file name like trace_<name>.json");
+                return;
+            }
+            std::string dir = (g_session_recorder ? g_session_recorder->getRecordingsDir() : "/tmp") + "/traces";
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+                sendControlResponse(client_fd, "error", "Cannot create trace directory " + dir);
+                return;
+            }
+            std::string path = dir + "/" + name;
+            struct stat existing;
+            if (lstat(path.c_str(), &existing) == 0) {
+                sendControlResponse(client_fd, "error", "Trace file already exists: " + name);
+                return;
+            }
+            tracer.start(path);
+            
+            json response;
+            response["type"] = "trace_started";
+            sendControlResponse(client_fd, response);
+        } else if (action == "stop") {
+            size_t event_count = 0;
+            std::string path = tracer.stop(&event_count);
+            if (path.empty()) {
+                sendControlResponse(client_fd, "error", "Tracing is not active");
+                return;
+            }
+            
+            json response;
+            response["type"] = "trace_stopped";
+            response["path"] = path;
+            response["event_count"] = event_count;
+            sendControlResponse(client_fd, response);
+        } else {
+            sendControlResponse(client_fd, "error", "Unknown trace action: " + action);
+        }
+    }
+    
     /**
      * Send a control response back to the client.
      */
@@ -1457,24 +7171,379 @@ private:
     }
     
     void sendControlResponse(int client_fd, const json& response) {
-        std::string json_str = response.dump();
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        writeMessage(client_fd, response.dump());
+    }
+    
+    /**
+     * Write one framed message. Caller holds send_mutex_, so messages from
+     * the ingest thread and the commit path never interleave.
+     */
+    bool writeMessage(int client_fd, const std::string& json_str, bool drop_if_full = false) {
+        int flags = MSG_NOSIGNAL | (drop_if_full ? MSG_DONTWAIT : 0);
+        
+        // SEQPACKET preserves message boundaries, so no length prefix
+        if (client_seqpacket_) {
+            return send(client_fd, json_str.c_str(), json_str.size(), flags) ==
+                   static_cast<ssize_t>(json_str.size());
+        }
         
-        // Send with same protocol: 4-byte length header + payload
+        // Send with same protocol: 4-byte length header + payload, as one
+        // buffer so a short write can't split the header from its payload
         uint32_t length = static_cast<uint32_t>(json_str.size());
-        uint8_t header[4];
-        header[0] = (length >> 24) & 0xFF;
-        header[1] = (length >> 16) & 0xFF;
-        header[2] = (length >> 8) & 0xFF;
-        header[3] = length & 0xFF;
+        std::string framed;
+        framed.reserve(4 + json_str.size());
+        framed.push_back(static_cast<char>((length >> 24) & 0xFF));
+        framed.push_back(static_cast<char>((length >> 16) & 0xFF));
+        framed.push_back(static_cast<char>((length >> 8) & 0xFF));
+        framed.push_back(static_cast<char>(length & 0xFF));
+        framed += json_str;
+        
+        if (drop_if_full) {
+            // Only start a message the send buffer can take whole; a stream
+            // message that is begun has to be finished to keep the framing
+            int sndbuf = 0;
+            socklen_t len = sizeof(sndbuf);
+            int pending = 0;
+            if (getsockopt(client_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) == 0 &&
+                ioctl(client_fd, SIOCOUTQ, &pending) == 0 &&
+                static_cast<size_t>(std::max(0, sndbuf - pending)) < framed.size()) {
+                return false;
+            }
+        }
+        
+        size_t offset = 0;
+        while (offset < framed.size()) {
+            ssize_t sent = send(client_fd, framed.data() + offset, framed.size() - offset,
+                                offset == 0 ? flags : MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            offset += static_cast<size_t>(sent);
+        }
+        return true;
+    }
+    
+    static constexpr size_t kMaxFrameBytes = 10 * 1024 * 1024;
+    
+    int port_;
+    int server_fd_;
+    std::string unix_path_;
+    int unix_type_;
+    int unix_fd_;
+    std::atomic<bool> running_;
+    std::thread server_thread_;
+    bool client_seqpacket_ = false;  // Framing of the currently connected client
+    std::mutex send_mutex_;          // Serializes writes to the client socket
+    int client_fd_ = -1;             // Connected client, guarded by send_mutex_
+    size_t transcode_threads_ = 0;
+    std::unique_ptr<FrameTranscodePool> transcode_pool_;
+    std::mutex h264_mutex_;  // Ingest and shm threads both feed the decoder
+    std::unique_ptr<H264StreamDecoder> h264_decoder_;  // Set for "codec":"h264" sessions
+    std::atomic<uint64_t> last_decoded_size_{0};  // (cols << 32 | rows) of the last decode
+    
+    // Optional shared-memory transport for the connected client
+    std::unique_ptr<ShmFrameRing> shm_ring_;
+    std::thread shm_thread_;
+    std::atomic<bool> shm_running_{false};
+    uint32_t shm_ring_counter_ = 0;
+};
+
+// ============================================================================
+// Stats HTTP Server - Prometheus /metrics plus liveness/readiness probes
+// ============================================================================
+
+/**
+ * Minimal HTTP/1.0 listener for scraping daemon internals.
+ * 
+ * Endpoints:
+ * - GET /metrics  Prometheus text exposition of counters, gauges, histograms
+ * - GET /healthz  Liveness: 503 if the SDK worker is stuck on one job
+ * - GET /readyz   Readiness: 503 while servers are down or the queue is backed up
+ */
+class StatsHttpServer {
+public:
+    StatsHttpServer(int port, const VideoInputServer& video_server,
+                    size_t ready_max_queue_depth, int liveness_max_job_seconds)
+        : port_(port), server_fd_(-1), running_(false), video_server_(video_server),
+          ready_max_queue_depth_(ready_max_queue_depth),
+          liveness_max_job_seconds_(liveness_max_job_seconds) {}
+    
+    ~StatsHttpServer() {
+        stop();
+    }
+    
+    bool start() {
+        server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (server_fd_ < 0) {
+            LOG(ERROR) << "Failed to create stats socket";
+            return false;
+        }
+        
+        int opt = 1;
+        setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port_);
+        
+        if (bind(server_fd_, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            LOG(ERROR) << "Failed to bind stats server to port " << port_;
+            close(server_fd_);
+            return false;
+        }
+        
+        if (listen(server_fd_, 5) < 0) {
+            LOG(ERROR) << "Failed to listen on stats socket";
+            close(server_fd_);
+            return false;
+        }
+        
+        running_ = true;
+        server_thread_ = std::thread(&StatsHttpServer::acceptLoop, this);
+        
+        LOG(INFO) << "Stats server listening on port " << port_;
+        return true;
+    }
+    
+    void stop() {
+        running_ = false;
+        if (server_fd_ >= 0) {
+            shutdown(server_fd_, SHUT_RDWR);
+            close(server_fd_);
+            server_fd_ = -1;
+        }
+        if (server_thread_.joinable()) {
+            server_thread_.join();
+        }
+    }
+    
+private:
+    void acceptLoop() {
+        while (running_ && g_running) {
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(server_fd_, &readfds);
+            
+            struct timeval tv;
+            tv.tv_sec = 1;
+            tv.tv_usec = 0;
+            
+            int activity = select(server_fd_ + 1, &readfds, NULL, NULL, &tv);
+            
+            if (activity < 0 && errno != EINTR) {
+                continue;
+            }
+            
+            if (activity > 0 && FD_ISSET(server_fd_, &readfds)) {
+                int client_fd = accept(server_fd_, NULL, NULL);
+                if (client_fd >= 0) {
+                    handleRequest(client_fd);
+                    close(client_fd);
+                }
+            }
+        }
+    }
+    
+    void handleRequest(int client_fd) {
+        // Scrapers send small requests; don't let a stalled client block the loop
+        struct timeval tv;
+        tv.tv_sec = 2;
+        tv.tv_usec = 0;
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t n = recv(client_fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                break;
+            }
+            request.append(chunk, n);
+        }
+        
+        // Request line: "GET /path HTTP/1.1"
+        std::istringstream line(request.substr(0, request.find("\r\n")));
+        std::string method, path;
+        line >> method >> path;
+        
+        if (method != "GET") {
+            sendResponse(client_fd, 405, "text/plain", "method not allowed\n");
+        } else if (path == "/metrics") {
+            sendResponse(client_fd, 200, "text/plain; version=0.0.4", renderMetrics());
+        } else if (path == "/healthz") {
+            std::string reason;
+            bool live = isLive(reason);
+            sendResponse(client_fd, live ? 200 : 503, "text/plain", live ? "ok\n" : reason + "\n");
+        } else if (path == "/readyz") {
+            std::string reason;
+            bool ready = isReady(reason);
+            sendResponse(client_fd, ready ? 200 : 503, "text/plain", ready ? "ok\n" : reason + "\n");
+        } else {
+            sendResponse(client_fd, 404, "text/plain", "not found\n");
+        }
+    }
+    
+    bool isLive(std::string& reason) const {
+        double job_seconds = g_sdk_processor ? g_sdk_processor->currentJobSeconds() : 0.0;
+        if (job_seconds > liveness_max_job_seconds_) {
+            reason = "sdk worker stuck on one job for " + std::to_string(static_cast<int>(job_seconds)) + "s";
+            return false;
+        }
+        return true;
+    }
+    
+    bool isReady(std::string& reason) const {
+        if (!g_metrics_server || !g_metrics_server->isRunning()) {
+            reason = "metrics server not running";
+            return false;
+        }
+        if (!video_server_.isRunning()) {
+            reason = "video input server not running";
+            return false;
+        }
+        size_t depth = g_sdk_processor ? g_sdk_processor->queueDepth() : 0;
+        if (depth > ready_max_queue_depth_) {
+            reason = "processing queue backed up (" + std::to_string(depth) + " segments)";
+            return false;
+        }
+        return true;
+    }
+    
+    std::string renderMetrics() const {
+        std::ostringstream out;
+        
+        auto counter = [&out](const char* name, const char* help, uint64_t value) {
+            out << "# HELP " << name << " " << help << "\n";
+            out << "# TYPE " << name << " counter\n";
+            out << name << " " << value << "\n";
+        };
+        auto gauge = [&out](const char* name, const char* help, double value) {
+            out << "# HELP " << name << " " << help << "\n";
+            out << "# TYPE " << name << " gauge\n";
+            out << name << " " << value << "\n";
+        };
+        
+        counter("presage_frames_received_total", "Video frames received on the ingest socket",
+                g_stats.frames_received.load());
+        counter("presage_frames_decoded_total", "Video frames decoded successfully",
+                g_stats.frames_decoded.load());
+        counter("presage_frames_decode_failed_total", "Video frames that failed to decode",
+                g_stats.frames_decode_failed.load());
+        counter("presage_bytes_received_total", "Bytes received on the ingest socket (frames only)",
+                g_stats.bytes_received.load());
+        counter("presage_recv_calls_total", "recv() syscalls issued on video sockets",
+                g_stats.recv_calls.load());
+        counter("presage_frames_resized_total", "Frames resized to the session resolution",
+                g_stats.frames_resized.load());
+        counter("presage_frame_pool_allocations_total", "Frame buffers allocated by the pool",
+                g_stats.frame_pool_allocations.load());
+        counter("presage_frame_pool_reuses_total", "Frame buffers recycled from the pool",
+                g_stats.frame_pool_reuses.load());
+        counter("presage_decode_allocations_total", "Decodes that allocated a new Mat",
+                g_stats.decode_allocations.load());
+        counter("presage_reduced_decodes_total", "JPEG frames decoded at a reduced DCT scale",
+                g_stats.frames_reduced_decode.load());
+        counter("presage_raw_frames_total", "Raw NV12/I420 frames received",
+                g_stats.frames_raw.load());
+        counter("presage_resize_allocations_total", "Resizes that allocated a new target",
+                g_stats.resize_allocations.load());
+        counter("presage_segments_finalized_total", "Recording segments finalized",
+                g_stats.segments_finalized.load());
+        counter("presage_metrics_broadcasts_total", "Messages broadcast on the metrics channel",
+                g_stats.metrics_broadcasts.load());
+        counter("presage_janitor_files_deleted_total", "Recording files deleted by the retention janitor",
+                g_stats.janitor_files_deleted.load());
+        counter("presage_janitor_bytes_deleted_total", "Recording bytes deleted by the retention janitor",
+                g_stats.janitor_bytes_deleted.load());
+        gauge("presage_recordings_bytes", "Bytes of recordings on disk at the last janitor sweep",
+              g_stats.recordings_bytes.load());
+        counter("presage_face_detections_total", "Recorded frames sampled by the face detector",
+                g_stats.face_detections.load());
+        counter("presage_segments_no_face_total", "Segments skipped for too little face coverage",
+                g_stats.segments_no_face.load());
+        counter("presage_frames_dropped_quality_total", "Frames dropped by the blur/exposure/motion screen",
+                g_stats.frames_dropped_quality.load());
+        counter("presage_quality_feedback_total", "quality_feedback messages sent to video clients",
+                g_stats.quality_feedback_sent.load());
+        counter("presage_quality_feedback_dropped_total",
+                "quality_feedback messages dropped because the video client was not reading",
+                g_stats.quality_feedback_dropped.load());
+        counter("presage_sdk_runs_aborted_total", "SDK runs stopped early on sustained bad imaging status",
+                g_stats.sdk_runs_aborted.load());
+        counter("presage_sdk_jobs_timed_out_total", "SDK jobs that passed their watchdog deadline",
+                g_stats.sdk_jobs_timed_out.load());
+        counter("presage_sdk_runners_abandoned_total", "SDK runner threads abandoned on a call that never returned",
+                g_stats.sdk_runners_abandoned.load());
+        counter("presage_sdk_worker_spawns_total", "SDK worker processes started",
+                g_stats.sdk_worker_spawns.load());
+        counter("presage_sdk_worker_crashes_total", "SDK worker processes that died mid-job",
+                g_stats.sdk_worker_crashes.load());
+        counter("presage_sdk_cache_hits_total", "SDK runs replayed from the result cache",
+                g_stats.sdk_cache_hits.load());
+        counter("presage_sdk_cache_misses_total", "SDK runs not found in the result cache",
+                g_stats.sdk_cache_misses.load());
+        counter("presage_sdk_cache_evictions_total", "SDK result cache entries evicted for space",
+                g_stats.sdk_cache_evictions.load());
+        gauge("presage_sdk_cache_bytes", "Size of the SDK result cache",
+              g_stats.sdk_cache_bytes.load());
+        counter("presage_frames_decimated_total", "Frames dropped by the recorder at reduced quality",
+                g_stats.frames_decimated.load());
+        gauge("presage_quality_level", "Adaptive quality level (0 = full quality)",
+              g_stats.quality_level.load());
+        
+        gauge("presage_processing_queue_depth", "Segments waiting for the SDK worker",
+              g_sdk_processor ? g_sdk_processor->queueDepth() : 0);
+        gauge("presage_sdk_current_job_seconds", "Runtime of the SDK job in progress",
+              g_sdk_processor ? g_sdk_processor->currentJobSeconds() : 0.0);
+        gauge("presage_recording_active", "1 while a session is being recorded",
+              (g_session_recorder && g_session_recorder->isRecording()) ? 1 : 0);
+        
+        std::vector<std::pair<int, int>> depths;
+        if (g_metrics_server) {
+            depths = g_metrics_server->clientSendQueueDepths();
+        }
+        gauge("presage_metrics_clients", "Connected metrics clients", depths.size());
+        out << "# HELP presage_metrics_client_send_queue_bytes Unsent bytes in each metrics client's socket\n";
+        out << "# TYPE presage_metrics_client_send_queue_bytes gauge\n";
+        for (const auto& [fd, pending] : depths) {
+            out << "presage_metrics_client_send_queue_bytes{client=\"" << fd << "\"} " << pending << "\n";
+        }
+        
+        g_stats.job_wait_seconds.render(out, "presage_job_wait_seconds",
+                                        "Time segments wait in the processing queue");
+        g_stats.job_run_seconds.render(out, "presage_job_run_seconds",
+                                       "SDK Run() time per segment");
+        g_stats.sdk_init_seconds.render(out, "presage_sdk_init_seconds",
+                                        "SDK container Initialize() time per segment");
         
-        send(client_fd, header, 4, MSG_NOSIGNAL);
-        send(client_fd, json_str.c_str(), json_str.size(), MSG_NOSIGNAL);
+        return out.str();
+    }
+    
+    void sendResponse(int client_fd, int code, const std::string& content_type, const std::string& body) {
+        const char* reason = code == 200 ? "OK" : code == 404 ? "Not Found" :
+                             code == 405 ? "Method Not Allowed" : "Service Unavailable";
+        std::ostringstream response;
+        response << "HTTP/1.0 " << code << " " << reason << "\r\n"
+                 << "Content-Type: " << content_type << "\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        std::string data = response.str();
+        send(client_fd, data.c_str(), data.size(), MSG_NOSIGNAL);
     }
     
     int port_;
     int server_fd_;
     std::atomic<bool> running_;
     std::thread server_thread_;
+    const VideoInputServer& video_server_;
+    size_t ready_max_queue_depth_;
+    int liveness_max_job_seconds_;
 };
 
 int main(int argc, char** argv) {
@@ -1482,6 +7551,12 @@ int main(int argc, char** argv) {
     google::InitGoogleLogging(argv[0]);
     FLAGS_alsologtostderr = true;
     
+    // Child started by SdkWorkerProcess: no servers, just SDK jobs
+    if (argc > 1 && std::string(argv[1]) == "--sdk-worker") {
+        std::signal(SIGINT, SIG_IGN);  // The daemon decides when its workers stop
+        return run_sdk_worker(load_config().api_key);
+    }
+    
     // Set up signal handlers
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
@@ -1493,13 +7568,31 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Configuration:";
     LOG(INFO) << "  Video input port: " << config.video_input_port;
     LOG(INFO) << "  Metrics output port: " << config.metrics_output_port;
+    if (!config.video_input_socket.empty()) {
+        LOG(INFO) << "  Video input socket: " << config.video_input_socket
+                  << " (" << socket_type_name(config.video_input_socket_type) << ")";
+    }
+    if (!config.metrics_output_socket.empty()) {
+        LOG(INFO) << "  Metrics output socket: " << config.metrics_output_socket
+                  << " (" << socket_type_name(config.metrics_output_socket_type) << ")";
+    }
     LOG(INFO) << "  Headless mode: " << (config.headless ? "true" : "false");
     LOG(INFO) << "  Recordings dir: " << config.recordings_dir;
     LOG(INFO) << "  Video FPS: " << config.video_fps;
     LOG(INFO) << "  Segment duration: " << config.segment_duration_seconds << "s";
+    LOG(INFO) << "  Recording codec: " << config.recording_codec;
+    LOG(INFO) << "  Transcode threads: " << config.transcode_threads;
+    LOG(INFO) << "  Stats port: " << (config.stats_port > 0 ? std::to_string(config.stats_port) : "disabled");
+    
+    if (!config.trace_path.empty()) {
+        PipelineTracer::instance().start(config.trace_path);
+    }
+    
+    g_frame_pool = std::make_unique<FrameBufferPool>(config.frame_pool_hugepages);
     
     // Start metrics server first (needed for SDK callbacks)
-    MetricsServer metrics_server(config.metrics_output_port);
+    MetricsServer metrics_server(config.metrics_output_port, config.metrics_output_socket,
+                                 config.metrics_output_socket_type);
     if (!metrics_server.start()) {
         LOG(FATAL) << "Failed to start metrics server";
         return 1;
@@ -1510,8 +7603,26 @@ int main(int argc, char** argv) {
     
     // Initialize SDK video processor
     g_sdk_processor = std::make_unique<SDKVideoProcessor>(
-        config.api_key, config.frame_width, config.frame_height);
+        config.api_key, config.frame_width, config.frame_height,
+        static_cast<size_t>(std::max(0, config.sdk_workers)), config.sdk_worker_memory_mb);
     LOG(INFO) << "SDK video processor initialized";
+    if (config.sdk_workers > 0) {
+        LOG(INFO) << "  SDK worker processes: " << config.sdk_workers
+                  << (config.sdk_worker_memory_mb > 0
+                      ? " (" + std::to_string(config.sdk_worker_memory_mb) + " MB limit each)" : "");
+    }
+    
+    SDKVideoProcessor::TailPolicy tail_policy = SDKVideoProcessor::TailPolicy::kMerge;
+    if (config.tail_policy == "skip") {
+        tail_policy = SDKVideoProcessor::TailPolicy::kSkip;
+    } else if (config.tail_policy == "process") {
+        tail_policy = SDKVideoProcessor::TailPolicy::kProcess;
+    } else if (config.tail_policy != "merge") {
+        LOG(WARNING) << "Unknown PRESAGE_TAIL_POLICY '" << config.tail_policy << "', using merge";
+    }
+    g_sdk_processor->setTailPolicy(tail_policy, std::max(0, config.min_segment_frames));
+    g_sdk_processor->setBadStatusAbort(config.bad_status_abort_seconds);
+    g_sdk_processor->setJobDeadline(config.job_deadline_factor, config.job_deadline_min_seconds);
     if (config.api_key.empty()) {
         LOG(WARNING) << "No API key configured - SDK processing may be limited";
     }
@@ -1523,21 +7634,138 @@ int main(int argc, char** argv) {
     
     // Wire up segment callback to SDK processor
     g_session_recorder->setSegmentReadyCallback(
-        [](const std::string& video_path, const std::string& session_id, size_t segment_index) {
+        [](const std::string& video_path, const std::string& session_id, size_t segment_index,
+           const PipelineTimestamps& timestamps, const SegmentEncodeStats& encode_stats) {
             if (g_sdk_processor) {
-                g_sdk_processor->queueSegment(video_path, session_id, segment_index);
+                g_sdk_processor->queueSegment(video_path, session_id, segment_index, timestamps,
+                                              encode_stats);
             }
         });
     
+    RecordingCodec recording_codec = RecordingCodec::kMJPG;
+    if (!parse_recording_codec(config.recording_codec, &recording_codec)) {
+        LOG(WARNING) << "Unknown PRESAGE_RECORDING_CODEC '" << config.recording_codec << "', using mjpg";
+    }
+    g_session_recorder->setDefaultCodec(recording_codec);
+    g_session_recorder->setWriteFrameTimestamps(config.frame_timestamps);
+    g_session_recorder->setSegmentRamp(parse_segment_ramp(config.segment_ramp),
+                                       static_cast<size_t>(std::max(0, config.min_segment_frames)));
+    
+    if (config.face_gate_coverage > 0.0 || config.face_crop) {
+        auto detector = std::make_unique<FaceDetector>();
+        if (detector->load(config.face_cascade)) {
+            g_session_recorder->setFaceDetector(std::move(detector), config.face_detect_interval);
+            if (config.face_gate_coverage > 0.0) {
+                g_sdk_processor->setFaceGate(config.face_gate_coverage);
+                LOG(INFO) << "Face gating enabled: segments need a face in " << config.face_gate_coverage * 100
+                          << "% of sampled frames (every " << config.face_detect_interval << " frames)";
+            }
+            if (config.face_crop) {
+                g_session_recorder->setFaceCrop(config.face_crop_size, config.face_crop_padding);
+                LOG(INFO) << "Face crop enabled: recording " << config.face_crop_size << "x"
+                          << config.face_crop_size << " around the face";
+            }
+        } else {
+            LOG(WARNING) << "Face gating and cropping disabled";
+        }
+    }
+    
+    std::vector<RecordingCodec> benchmark_codecs = parse_recording_codec_list(config.codec_benchmark);
+    if (!benchmark_codecs.empty()) {
+        g_session_recorder->setBenchmarkCodecs(benchmark_codecs);
+        g_codec_benchmark = std::make_unique<CodecBenchmark>();
+        LOG(INFO) << "Codec benchmark enabled: rotating " << config.codec_benchmark << " per segment";
+    }
+    
     LOG(INFO) << "Session recorder initialized with " << config.segment_duration_seconds 
               << "s segments - recordings will be saved to " << config.recordings_dir;
     
-    VideoInputServer video_server(config.video_input_port);
+    if (config.adaptive_quality) {
+        g_quality_controller = std::make_unique<AdaptiveQualityController>(config.adaptive_queue_high);
+        LOG(INFO) << "Adaptive quality enabled (falling behind at " << config.adaptive_queue_high
+                  << " queued segments)";
+    }
+
+    // Retention janitor (only when a policy is configured)
+    if (config.retention_delete_processed || config.retention_hours > 0 || config.retention_max_mb > 0) {
+        RecordingJanitor::Policy policy;
+        policy.delete_processed = config.retention_delete_processed;
+        policy.retention_hours = config.retention_hours;
+        policy.max_bytes = config.retention_max_mb * 1024 * 1024;
+        policy.interval_seconds = std::max(1, config.janitor_interval_seconds);
+        g_recording_janitor = std::make_unique<RecordingJanitor>(config.recordings_dir, policy);
+        LOG(INFO) << "Recording janitor enabled (delete_processed=" << policy.delete_processed
+                  << ", retention_hours=" << policy.retention_hours
+                  << ", max_mb=" << config.retention_max_mb << ")";
+    }
+    
+    if (!config.sdk_cache_dir.empty()) {
+        g_sdk_result_cache = std::make_unique<SdkResultCache>(config.sdk_cache_dir,
+                                                              config.sdk_cache_max_mb * 1024 * 1024);
+        if (g_sdk_result_cache->open()) {
+            LOG(INFO) << "SDK result cache enabled in " << config.sdk_cache_dir
+                      << " (max " << config.sdk_cache_max_mb << " MB)";
+        } else {
+            LOG(WARNING) << "SDK result cache disabled";
+            g_sdk_result_cache.reset();
+        }
+    }
+    
+    // Resume segments that were queued but not processed before the last exit
+    if (!config.journal_path_set) {
+        config.journal_path = config.recordings_dir + "/segment_journal.jsonl";
+    }
+    if (!config.journal_path.empty()) {
+        g_segment_journal = std::make_unique<SegmentJournal>(config.journal_path, config.journal_fsync_ms);
+        std::vector<SegmentJournal::PendingJob> pending;
+        if (!g_segment_journal->open(&pending)) {
+            LOG(WARNING) << "Segment journal disabled";
+            g_segment_journal.reset();
+            pending.clear();  // May be partly filled; nothing to resume without the journal
+        }
+        for (const auto& job : pending) {
+            struct stat video_stat;
+            if (stat(job.video_path.c_str(), &video_stat) != 0) {
+                LOG(WARNING) << "Journaled segment missing, marking done: " << job.video_path;
+                g_segment_journal->recordComplete(job.job_id);
+                continue;
+            }
+            LOG(INFO) << "Resuming segment " << job.segment_index << " of session " << job.session_id;
+            g_sdk_processor->queueSegment(job.video_path, job.session_id, job.segment_index, {}, {}, job.job_id);
+        }
+    }
+    
+    
+    VideoInputServer video_server(config.video_input_port, config.video_input_socket,
+                                  config.video_input_socket_type);
+    video_server.setTranscodeThreads(config.transcode_threads);
+    if (config.quality_screen) {
+        FrameQualityScreen::Thresholds thresholds;
+        thresholds.min_sharpness = config.quality_min_sharpness;
+        thresholds.max_clipped = config.quality_max_clipped;
+        thresholds.max_motion = config.quality_max_motion;
+        g_session_recorder->setQualityScreen(thresholds, [&video_server](const json& message) {
+            return video_server.sendToClient(message);
+        });
+        LOG(INFO) << "Frame quality screening enabled";
+    }
     if (!video_server.start()) {
         LOG(FATAL) << "Failed to start video input server";
         return 1;
     }
     
+    // Stats endpoint is optional - a failure to bind is logged but not fatal
+    std::unique_ptr<StatsHttpServer> stats_server;
+    if (config.stats_port > 0) {
+        stats_server = std::make_unique<StatsHttpServer>(
+            config.stats_port, video_server, config.ready_max_queue_depth,
+            config.liveness_max_job_seconds);
+        if (!stats_server->start()) {
+            LOG(WARNING) << "Stats server disabled";
+            stats_server.reset();
+        }
+    }
+    
     // Send startup notification
     metrics_server.broadcast(status_to_json("ready", "Presage daemon started (SDK integration)"));
     
@@ -1558,10 +7786,21 @@ int main(int argc, char** argv) {
     // Send shutdown notification
     metrics_server.broadcast(status_to_json("shutdown", "Presage daemon stopping"));
     
+    if (stats_server) {
+        stats_server->stop();
+    }
+    
+    // Flush a trace that was still running (no-op when tracing is off)
+    PipelineTracer::instance().stop();
+    
     // Cleanup global pointers
     g_metrics_server = nullptr;
     g_sdk_processor.reset();
+    g_quality_controller.reset();
+    g_recording_janitor.reset();
+    g_sdk_result_cache.reset();
     g_session_recorder.reset();
+    g_segment_journal.reset();
     
     LOG(INFO) << "Presage Daemon shutdown complete.";
     return 0;